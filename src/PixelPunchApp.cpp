@@ -85,6 +85,12 @@ class PixelPunchApp : public App {
     float                   mMixThreshold;
     bool                    mPrevDiffWithSmoothBicubic;
     bool                    mDiffWithSmoothBicubic;
+    int                     mPrevSupersampling;
+    int                     mSupersampling;
+    bool                    mPrevWrapEdges;
+    bool                    mWrapEdges;
+    bool                    mPrevFixedPoint;
+    bool                    mFixedPoint;
     float                   mViewScale;
     bool                    mDisplaySource;
     // DATA
@@ -92,6 +98,9 @@ class PixelPunchApp : public App {
     Surface                 mSourceImage;
     Surface                 mOrigImage;
     Surface                 mScaledSrc;
+    pp::CoordinateMap       mCoordinates;   // of the current quad, kept while only the sampling changes
+    pp::SwapScores          mMixScores;     // Bilinear Mix up to the threshold, empty until needed
+    pp::Palette             mSourcePalette;  // colors of mSourceImage, empty until needed
     gl::TextureRef             mPrevTexture;
     Surface                 mResultImage;
     gl::TextureRef             mResultTexture;
@@ -121,24 +130,28 @@ void PixelPunchApp::initOptions()
     // TRANSFORM OPTIONS
     mTransformOptions[pp::TM_IDENTITY] = "None";
     mTransformOptions[pp::TM_PROJECTIVE] = "Projective";
+    mTransformOptions[pp::TM_ROTATE_SHEAR] = "Rotate by Shears";
     mTransformOptions[pp::TM_BILINEAR] = "Bilinear";
     mTransformMethod = pp::TM_IDENTITY;
 
     // TRANSFORM OPTIONS
     mTransformOptions[pp::TM_IDENTITY] = "None";
     mTransformOptions[pp::TM_PROJECTIVE] = "Projective";
+    mTransformOptions[pp::TM_ROTATE_SHEAR] = "Rotate by Shears";
     mTransformOptions[pp::TM_BILINEAR] = "Bilinear";
 
     // SAMPLING OPTIONS
     mSamplingOptions[pp::SAMPLE_NEAREST] = "Nearest";
     mSamplingOptions[pp::SAMPLE_BILINEAR] = "Smooth Bilinear";
     mSamplingOptions[pp::SAMPLE_BICUBIC] = "Smooth Bicubic";
+    mSamplingOptions[pp::SAMPLE_AREA] = "Smooth Area";
     mSamplingOptions[pp::SAMPLE_FIRST_BILINEAR] = "Major Bilinear";
     mSamplingOptions[pp::SAMPLE_SECOND_BILINEAR] = "Second Bilinear";
     mSamplingOptions[pp::SAMPLE_BEST_FIT_NARROW] = "Best Fit Narrow";
     mSamplingOptions[pp::SAMPLE_BEST_FIT_WIDE] = "Best Fit Wide";
     mSamplingOptions[pp::SAMPLE_BEST_FIT_ANY] = "Best Fit Any";
     mSamplingOptions[pp::SAMPLE_MINIMIZE_ERROR] = "Bilinear Mix";
+    mSamplingOptions[pp::SAMPLE_ROTSPRITE] = "RotSprite";
     mSamplingMethod = pp::SAMPLE_NEAREST;
 }
 
@@ -183,6 +196,9 @@ void PixelPunchApp::setup()
     }
     mGui->addParam("Mix Threshold", &mMixThreshold, 0.0f, 1.0f, 0.5f);  // if we specify group id, we create radio button set
     mGui->addParam("Show Diff", &mDiffWithSmoothBicubic, false);
+    mGui->addParam("Supersampling", &mSupersampling, 1, 4, 1);
+    mGui->addParam("Wrap Edges", &mWrapEdges, false);
+    mGui->addParam("Fixed Point", &mFixedPoint, false);
     mPerfLabel = mGui->addLabel("Perf: 0 ms");
 
     mGui->addColumn();
@@ -207,6 +223,7 @@ void PixelPunchApp::fileDrop(FileDropEvent event)
     mPrevTexture->setMagFilter(GL_NEAREST);
     mResultImage = Surface();
     mScaledSrc = Surface();
+    mSourcePalette.clear();
 
     mTransformUI.setShape(cinder::Rectf(0, 0, static_cast<float>(mSourceImage.getWidth()), static_cast<float>(mSourceImage.getHeight())));
     mTransformUI.center();
@@ -244,11 +261,17 @@ void PixelPunchApp::validateResultImage()
     isValid = isValid &&(newSamplingMethod == mSamplingMethod);
     isValid = isValid &&(mPrevMixThreshold == mMixThreshold);
     isValid = isValid &&(mPrevDiffWithSmoothBicubic == mDiffWithSmoothBicubic);
+    isValid = isValid &&(mPrevSupersampling == mSupersampling);
+    isValid = isValid &&(mPrevWrapEdges == mWrapEdges);
+    isValid = isValid &&(mPrevFixedPoint == mFixedPoint);
 
     if (mSourceImage.getData() && !isValid)
     {
         mPrevMixThreshold = mMixThreshold;
         mPrevDiffWithSmoothBicubic = mDiffWithSmoothBicubic;
+        mPrevSupersampling = mSupersampling;
+        mPrevWrapEdges = mWrapEdges;
+        mPrevFixedPoint = mFixedPoint;
         double t1 = getElapsedSeconds();
 
         if (mResultTexture)
@@ -259,6 +282,7 @@ void PixelPunchApp::validateResultImage()
         {
             mScaleMethod = newScaleMethod;
             mScaledSrc = pp::scale(mSourceImage, mScaleMethod);
+            mMixScores = pp::SwapScores();
         }
 
         // TRANSFORM
@@ -269,91 +293,39 @@ void PixelPunchApp::validateResultImage()
             mResultImage = mScaledSrc;
         } else {
             pp::TransformMapping tfx = pp::TransformMapping(mTransformUI.shape);
+            if (!mCoordinates.isFor(mScaledSrc.getBounds(), tfx, mTransformMethod, mFixedPoint))
+            {
+                mCoordinates = pp::CoordinateMap(mScaledSrc.getBounds(), tfx, mTransformMethod, mFixedPoint);
+                mMixScores = pp::SwapScores();
+            }
             // SAMPLING
             mSamplingMethod = newSamplingMethod;
-            pp::Palette colors;
-
-            switch (mSamplingMethod)
+            pp::TransformOptions options;
+            options.supersampling = mSupersampling;
+            options.fixedPoint = mFixedPoint;
+            pp::SamplingOptions sampling;
+            // tileable sources blend across their opposite edges
+            sampling.border = mWrapEdges ? pp::PixelBuffer::BORDER_WRAP : pp::PixelBuffer::BORDER_CLAMP;
+
+            if (mSamplingMethod == pp::SAMPLE_MINIMIZE_ERROR)
             {
-                case pp::SAMPLE_NEAREST:
-                {
-                    pp::NearestNeighbourSampler NNS = pp::NearestNeighbourSampler(mScaledSrc);
-                    mResultImage = pp::transform(NNS, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_BILINEAR:
-                {
-                    pp::BilinearSampler BS = pp::BilinearSampler(mScaledSrc);
-                    mResultImage = pp::transform(BS, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_BICUBIC:
-                {
-                    pp::BicubicSampler BCS = pp::BicubicSampler(mScaledSrc);
-                    mResultImage = pp::transform(BCS, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_FIRST_BILINEAR:
-                {
-                    pp::BilinearDominanceSampler BDSF = pp::BilinearDominanceSampler(mScaledSrc, 0);
-                    mResultImage = pp::transform(BDSF, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_SECOND_BILINEAR:
-                {
-                    pp::BilinearDominanceSampler BDSS = pp::BilinearDominanceSampler(mScaledSrc, 1);
-                    mResultImage = pp::transform(BDSS, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_BEST_FIT_NARROW:
-                {
-                    pp::BicubicBestFitSampler BSFS = pp::BicubicBestFitSampler(mScaledSrc, false);
-                    mResultImage = pp::transform(BSFS, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_BEST_FIT_WIDE:
-                {
-                    pp::BicubicBestFitSampler BSFW = pp::BicubicBestFitSampler(mScaledSrc, true);
-                    mResultImage = pp::transform(BSFW, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_BEST_FIT_ANY:
-                {
-                    pp::getColors(mSourceImage, colors);
-                    pp::BicubicBestFitSampler BBFS = pp::BicubicBestFitSampler(mScaledSrc, colors);
-                    mResultImage = pp::transform(BBFS, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_FIRST_WEIGHT:
-                {
-                    pp::WeightSampler WSF = pp::WeightSampler(mScaledSrc, 0);
-                    mResultImage = pp::transform(WSF, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_SECOND_WEIGHT:
-                {
-                    pp::WeightSampler WSS = pp::WeightSampler(mScaledSrc, 1);
-                    mResultImage = pp::transform(WSS, tfx, mTransformMethod);
-                    break;
-                }
-                case pp::SAMPLE_MINIMIZE_ERROR:
+                // moving the threshold only redoes the final select
+                if (mMixScores.scores.empty())
+                    mMixScores = pp::mixScores(mScaledSrc, mCoordinates);
+                mResultImage = pp::choose(mMixScores, mMixThreshold*mMixThreshold);
+            } else {
+                if (mSamplingMethod == pp::SAMPLE_BEST_FIT_ANY)
                 {
-                    pp::BicubicSampler BCS = pp::BicubicSampler(mScaledSrc);
-                    pp::BilinearDominanceSampler BDSF = pp::BilinearDominanceSampler(mScaledSrc, 0);
-                    pp::BilinearDominanceSampler BDSS = pp::BilinearDominanceSampler(mScaledSrc, 1);
-                    pp::WeightSampler WSF = pp::WeightSampler(mScaledSrc, 0);
-                    Surface bicubic = pp::transform(BCS, tfx, mTransformMethod);
-                    Surface first = pp::transform(BDSF, tfx, mTransformMethod);
-                    Surface second = pp::transform(BDSS, tfx, mTransformMethod);
-                    Surface secondWeight = pp::transform(WSF, tfx, mTransformMethod);
-                    Surface compare = pp::compare(bicubic, first);
-                    mResultImage = pp::choose(first, second, compare, secondWeight, mMixThreshold*mMixThreshold);
+                    if (mSourcePalette.empty())
+                        pp::getColors(mSourceImage, mSourcePalette);
+                    sampling.palette = &mSourcePalette;
                 }
+                mResultImage = pp::transform(mScaledSrc, mSamplingMethod, mCoordinates, options, sampling);
             }
             if (mDiffWithSmoothBicubic)
             {
                 pp::BicubicSampler BCS = pp::BicubicSampler(mScaledSrc);
-                Surface bicubic = pp::transform(BCS, tfx, mTransformMethod);
+                Surface bicubic = pp::transform(BCS, mCoordinates);
                 mResultImage = pp::compare(bicubic, mResultImage);
             }
         }
@@ -459,6 +431,7 @@ void PixelPunchApp::reloadImage()
                     mPrevTexture->setMagFilter(GL_NEAREST);
                     mResultImage = Surface();
                     mScaledSrc = Surface();
+                    mSourcePalette.clear();
 //                  mTransformUI.setShape(cinder::Rectf(0,0,(float)mSourceImage.getWidth(),(float)mSourceImage.getHeight()));
             }
         }
@@ -540,6 +513,7 @@ void PixelPunchApp::openImageFromDialog()
             mPrevTexture->setMagFilter(GL_NEAREST);
             mResultImage = Surface();
             mScaledSrc = Surface();
+            mSourcePalette.clear();
 
             mTransformUI.setShape(cinder::Rectf(0, 0, static_cast<float>(mSourceImage.getWidth()), static_cast<float>(mSourceImage.getHeight())));
             mTransformUI.center();
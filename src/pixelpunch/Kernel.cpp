@@ -1,28 +1,29 @@
 #include "Kernel.h"
+#include <algorithm>
 
 using namespace pp;
 using namespace cinder;
 
 Kernel::Kernel(Surface& source, int width, int height, int centerX, int centerY)
-:   mIter(source.getIter()),
+:   mSurface(source),
     mWidth(width),
     mHeight(height),
     mOffsetX(-centerX),
-    mOffsetY(-centerY)
+    mOffsetY(-centerY),
+    mX(0),
+    mY(0)
 {
-    mHasAlpha = source.hasAlpha();
-    Area range = source.getBounds();
+    // wide enough for every cell of the window while it is on the surface
+    int padding = std::max(std::max(centerX, mWidth - 1 - centerX), std::max(centerY, mHeight - 1 - centerY));
+    mBuffer = PixelBuffer(source, padding);
 
-    // range.x2 -= (mWidth + paddingX);
-    // range.y2 -= (mHeight + paddingY);
     // prepare data storage
     pixels = (uint32_t**)malloc(mWidth * mHeight * sizeof(*pixels));
     for (int i = 0; i < mWidth; ++i)
     {        
         pixels[i] = (uint32_t*)malloc(mHeight * sizeof(*pixels[0]));
     }
-    mIter = source.getIter(range);
-    mValid = mIter.line() & mIter.pixel();
+    mValid = source.getWidth() > 0 && source.getHeight() > 0;
 }
 
 Kernel::~Kernel()
@@ -46,55 +47,110 @@ bool Kernel::copy(const Kernel& from)
 
 bool Kernel::step(int stepsH, int stepsV)
 {
+    int width = mBuffer.getWidth();
+    int height = mBuffer.getHeight();
     // step right
-    for (int i = 0; mIter.mX < mIter.mEndX && i < stepsH; i++)
+    mX = std::min(mX + stepsH, width);
+    // end of line? step down!
+    if (mX == width && stepsV > 0 && mY < height)
     {
-        ++mIter.mX;
-        mIter.mPtr += mIter.mInc;
+        mY = std::min(mY + stepsV, height);
+        mX = 0;
     }
-    // end of line? step down!
-    if (mIter.mX == mIter.mEndX)
-        for (int i = 0;  mIter.mY < mIter.mEndY && i < stepsV; i++)
-        {
-            ++mIter.mY;
-            mIter.mLinePtr += mIter.mRowInc;
-            mIter.mPtr = reinterpret_cast<uint8_t*>(mIter.mLinePtr);
-            mIter.mX = mIter.mStartX;
-        }
 
-    return (mIter.mY < mIter.mEndY);
+    return (mY < height);
 }
 
 bool Kernel::write(int steps)
 {
-    for (int x = 0, ox = mOffsetX; x < mWidth; x++, ox++)
-        for (int y = 0, oy = mOffsetY; y < mHeight; y++, oy++)
+    if (!mValid)
+        return false;
+
+    int left = mX + mOffsetX;
+    int top = mY + mOffsetY;
+    // the padding copies the pixels near the edge, writes there go through setPixel to update it
+    int band = mBuffer.getPadding();
+    bool inside = left >= band && top >= band && left + mWidth <= mBuffer.getWidth() - band && top + mHeight <= mBuffer.getHeight() - band;
+    for (int x = 0; x < mWidth; x++)
+        for (int y = 0; y < mHeight; y++)
         {
-            uint32_t r = 0xFF & (pixels[x][y] >> 16);
-            uint32_t g = 0xFF & (pixels[x][y] >> 8);
-            uint32_t b = 0xFF &  pixels[x][y];
-            mIter.rClamped(ox, oy) = r;
-            mIter.gClamped(ox, oy) = g;
-            mIter.bClamped(ox, oy) = b;
+            // only the color is written, alpha stays
+            if (inside)
+            {
+                uint32_t* p = mBuffer.getRow(top + y) + left + x;
+                *p = (*p & 0xFF000000) | (pixels[x][y] & 0x00FFFFFF);
+            }
+            else
+            {
+                // cells off the surface land on its edge, the last one written wins
+                int cx = std::min(std::max(left + x, 0), mBuffer.getWidth() - 1);
+                int cy = std::min(std::max(top + y, 0), mBuffer.getHeight() - 1);
+                uint32_t alpha = mBuffer.getPixel(cx, cy) & 0xFF000000;
+                mBuffer.setPixel(cx, cy, alpha | (pixels[x][y] & 0x00FFFFFF));
+            }
         }
 
-    return step(steps, steps);
+    if (step(steps, steps))
+        return true;
+    flush();
+    return false;
 }
 
-bool Kernel::read(int steps)
+bool Kernel::fill(uint32_t color, int count, int steps)
 {
     if (!mValid)
         return false;
 
-    for (int x = 0, ox = mOffsetX; x < mWidth; x++, ox++)
-        for (int y = 0, oy = mOffsetY; y < mHeight; y++, oy++)
+    int left = mX + mOffsetX;
+    int top = mY + mOffsetY;
+    int right = left + (count - 1) * steps + mWidth;
+    // runs that reach the pixels copied into the padding are written one window at a time
+    int band = mBuffer.getPadding();
+    if (steps != mWidth || left < band || top < band || right > mBuffer.getWidth() - band || top + mHeight > mBuffer.getHeight() - band)
+    {
+        bool more = true;
+        for (int i = 0; i < count && more; i++)
         {
-            uint32_t r = mIter.rClamped(ox, oy);
-            uint32_t g = mIter.gClamped(ox, oy);
-            uint32_t b = mIter.bClamped(ox, oy);
-            uint32_t c = ((r << 16) & 0x00FF0000) + ((g << 8) & 0x0000FF00) + (b & 0x000000FF);
-            pixels[x][y] = c;  // TODO(lithander): Consider Alpha << mIter.a(x,y);
+            for (int x = 0; x < mWidth; x++)
+                for (int y = 0; y < mHeight; y++)
+                    pixels[x][y] = color;
+            more = write(steps);
         }
+        return more;
+    }
+
+    // windows side by side on the surface, one span per row; only the color is written
+    for (int y = 0; y < mHeight; y++)
+    {
+        uint32_t* p = mBuffer.getRow(top + y) + left;
+        for (int x = 0; x < right - left; x++)
+            p[x] = (p[x] & 0xFF000000) | (color & 0x00FFFFFF);
+    }
+
+    if (step(count * steps, steps))
+        return true;
+    flush();
+    return false;
+}
+
+bool Kernel::read(int steps)
+{
+    if (!mValid || mY >= mBuffer.getHeight())
+        return false;
+
+    for (int y = 0; y < mHeight; y++)
+    {
+        // the padding holds the clamped pixels
+        const uint32_t* row = mBuffer.getRow(mY + mOffsetY + y) + mX + mOffsetX;
+        for (int x = 0; x < mWidth; x++)
+            pixels[x][y] = row[x] & 0x00FFFFFF;  // TODO(lithander): Consider Alpha
+    }
 
     return step(steps, steps);
 }
+
+void Kernel::flush()
+{
+    for (int y = 0; y < mBuffer.getHeight(); y++)
+        storeRow(mSurface, 0, y, mBuffer.getRow(y), mBuffer.getWidth());
+}
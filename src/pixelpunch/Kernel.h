@@ -2,10 +2,14 @@
 
 #include "cinder/Cinder.h"
 #include "cinder/Surface.h"
-#include "cinder/Area.h"
+#include "PixelBuffer.h"
 
 namespace pp
 {
+// Window of width x height pixels walking over a Surface, reads and writes of the cells
+// outside the surface are clamped to its edge. The surface is copied once into a buffer
+// padded to the window, so reads are plain pointer arithmetic; writes go into the same
+// buffer, later reads see them, and reach the surface once the walk is complete.
 class Kernel
 {
  public:
@@ -14,17 +18,23 @@ class Kernel
         bool step(int stepsH, int stepsV);
         bool read(int steps = 1);
         bool write(int steps = 1);
+        // 'count' writes of the window full of color, a run along the row that does not wrap
+        bool fill(uint32_t color, int count, int steps);
         bool copy(const Kernel& from);
-        cinder::Surface::Iter& iter() { return mIter; }
+        const PixelBuffer& getBuffer() const { return mBuffer; }  // padded copy of the surface
         uint32_t** pixels;
 
  private:
-        cinder::Surface::Iter mIter;
-        bool mHasAlpha;
+        void flush();
+
+        cinder::Surface mSurface;
+        PixelBuffer mBuffer;
         bool mValid;
         int mWidth;
         int mHeight;
         int mOffsetX;
         int mOffsetY;
+        int mX;
+        int mY;
 };
 }
@@ -0,0 +1,486 @@
+#include "PixelBuffer.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace cinder;
+using namespace pp;
+
+namespace
+{
+    void _rowMajor(PixelAddressing& addressing, const uint32_t* base, int width, int padding)
+    {
+        addressing.base = base;
+        addressing.shift = 31;
+        addressing.lastTileX = 0;
+        addressing.lastTileY = 0;
+        addressing.tileSize = 0;
+        addressing.stride = width + 2 * padding;
+        addressing.corner = padding * addressing.stride + padding;
+    }
+
+    //  the inner coordinate that padding coordinate v shows, -1 for none
+    int _borderSource(int v, int size, PixelBuffer::Border border)
+    {
+        if (v >= 0 && v < size)
+            return v;
+        switch (border)
+        {
+        case PixelBuffer::BORDER_TRANSPARENT:
+            return -1;
+        case PixelBuffer::BORDER_WRAP:
+            v %= size;
+            return (v < 0) ? v + size : v;
+        case PixelBuffer::BORDER_MIRROR:
+            v %= 2 * size;
+            if (v < 0)
+                v += 2 * size;
+            return (v < size) ? v : 2 * size - 1 - v;
+        default:
+            return std::min(std::max(v, 0), size - 1);
+        }
+    }
+
+    //  open addressed set of up to 256 packed colors and their indices
+    struct _ColorTable
+    {
+        static const int SLOTS = 1024;
+        _ColorTable() { std::fill(indices, indices + SLOTS, -1); }
+
+        //  the slot holding pixel or the empty one it goes into
+        int slot(uint32_t pixel) const
+        {
+            int s = (pixel * 2654435761u) >> 22;
+            while (indices[s] >= 0 && keys[s] != pixel)
+                s = (s + 1) & (SLOTS - 1);
+            return s;
+        }
+
+        uint32_t keys[SLOTS];
+        int indices[SLOTS];     // -1 for empty slots
+    };
+}
+
+PixelBuffer::PixelBuffer()
+:   mLayout(ROW_MAJOR),
+    mBorder(BORDER_CLAMP),
+    mWidth(0),
+    mHeight(0),
+    mPadding(0)
+{
+    _rowMajor(mAddressing, NULL, 0, 0);
+}
+
+PixelBuffer::PixelBuffer(const Surface& source, int padding, Layout layout, Border border)
+:   mLayout(ROW_MAJOR),
+    mBorder(border),
+    mWidth(source.getWidth()),
+    mHeight(source.getHeight()),
+    mPadding(padding)
+{
+    int stride = mWidth + 2 * mPadding;
+    int rows = mHeight + 2 * mPadding;
+    mData = std::make_shared<std::vector<uint32_t> >(stride * rows);
+    _rowMajor(mAddressing, &(*mData)[0], mWidth, mPadding);
+
+    // pack the inner pixels
+    const uint8_t* srcData = source.getData();
+    int rowBytes = source.getRowBytes();
+    int inc = source.getPixelInc();
+    int r = source.getRedOffset();
+    int g = source.getGreenOffset();
+    int b = source.getBlueOffset();
+    int a = source.hasAlpha() ? source.getAlphaOffset() : -1;
+    for (int y = 0; y < mHeight; y++)
+    {
+        const uint8_t* src = srcData + y * rowBytes;
+        uint32_t* dst = getRow(y);
+        for (int x = 0; x < mWidth; x++, src += inc)
+        {
+            uint32_t alpha = (a < 0) ? 0xFF : src[a];
+            dst[x] = (alpha << 24) | (uint32_t(src[r]) << 16) | (uint32_t(src[g]) << 8) | uint32_t(src[b]);
+        }
+    }
+
+    fillPadding(border);
+    if (layout == TILED)
+        tile();
+}
+
+PixelBuffer::PixelBuffer(int width, int height, int padding)
+:   mLayout(ROW_MAJOR),
+    mBorder(BORDER_CLAMP),
+    mWidth(width),
+    mHeight(height),
+    mPadding(padding)
+{
+    mData = std::make_shared<std::vector<uint32_t> >((mWidth + 2 * mPadding) * (mHeight + 2 * mPadding));
+    _rowMajor(mAddressing, &(*mData)[0], mWidth, mPadding);
+}
+
+void PixelBuffer::fillPadding(Border border)
+{
+    assert(mLayout == ROW_MAJOR);
+    mBorder = border;
+    if (mWidth == 0 || mHeight == 0)
+        return;
+
+    //  columns first, then whole padded rows, as every mode treats x and y alike
+    uint32_t* data = &(*mData)[0];
+    int stride = mAddressing.stride;
+    for (int y = 0; y < mHeight; y++)
+    {
+        uint32_t* line = getRow(y);
+        for (int x = -mPadding; x < 0; x++)
+        {
+            int left = _borderSource(x, mWidth, border);
+            int right = _borderSource(mWidth - 1 - x, mWidth, border);
+            line[x] = (left < 0) ? 0 : line[left];
+            line[mWidth - 1 - x] = (right < 0) ? 0 : line[right];
+        }
+    }
+    for (int y = -mPadding; y < 0; y++)
+    {
+        int bottom = mHeight - 1 - y;
+        int top = _borderSource(y, mHeight, border);
+        int below = _borderSource(bottom, mHeight, border);
+        uint32_t* topLine = data + (y + mPadding) * stride;
+        uint32_t* bottomLine = data + (bottom + mPadding) * stride;
+        if (top < 0)
+            memset(topLine, 0, stride * sizeof(uint32_t));
+        else
+            memcpy(topLine, data + (top + mPadding) * stride, stride * sizeof(uint32_t));
+        if (below < 0)
+            memset(bottomLine, 0, stride * sizeof(uint32_t));
+        else
+            memcpy(bottomLine, data + (below + mPadding) * stride, stride * sizeof(uint32_t));
+    }
+}
+
+void PixelBuffer::setPixel(int x, int y, uint32_t pixel)
+{
+    assert(mLayout == ROW_MAJOR);
+    getRow(y)[x] = pixel;
+    bool nearEdge = x < mPadding || y < mPadding || x >= mWidth - mPadding || y >= mHeight - mPadding;
+    if (!nearEdge || mBorder == BORDER_TRANSPARENT)
+        return;
+
+    //  padding coordinates showing x and y, each of them at most 2 * padding + 1
+    std::vector<int> columns(1, x);
+    std::vector<int> rows(1, y);
+    for (int v = -mPadding; v < 0; v++)
+    {
+        if (_borderSource(v, mWidth, mBorder) == x)
+            columns.push_back(v);
+        if (_borderSource(mWidth - 1 - v, mWidth, mBorder) == x)
+            columns.push_back(mWidth - 1 - v);
+        if (_borderSource(v, mHeight, mBorder) == y)
+            rows.push_back(v);
+        if (_borderSource(mHeight - 1 - v, mHeight, mBorder) == y)
+            rows.push_back(mHeight - 1 - v);
+    }
+    for (size_t j = 0; j < rows.size(); j++)
+    {
+        uint32_t* line = getRow(rows[j]);
+        for (size_t i = 0; i < columns.size(); i++)
+            line[columns[i]] = pixel;
+    }
+}
+
+//  copies the padded row-major pixels into tiles, each padded with the pixels around it
+void PixelBuffer::tile()
+{
+    std::shared_ptr<std::vector<uint32_t> > rows = mData;
+    const uint32_t* origin = getOrigin();
+    int rowStride = mAddressing.stride;
+
+    int tilesX = (mWidth + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (mHeight + TILE_SIZE - 1) / TILE_SIZE;
+    int stride = TILE_SIZE + 2 * mPadding;
+    int tileSize = stride * stride;
+    mData = std::make_shared<std::vector<uint32_t> >(tilesX * tilesY * tileSize);
+    uint32_t* data = &(*mData)[0];
+    for (int ty = 0; ty < tilesY; ty++)
+        for (int tx = 0; tx < tilesX; tx++)
+        {
+            //  the last tiles of a row/column reach past the image, their surplus pixels are
+            //  never addressed and only filled up to the padding of the image
+            int x0 = tx * TILE_SIZE - mPadding;
+            int y0 = ty * TILE_SIZE - mPadding;
+            int columns = std::min(stride, mWidth + mPadding - x0);
+            int lines = std::min(stride, mHeight + mPadding - y0);
+            uint32_t* dst = data + (ty * tilesX + tx) * tileSize;
+            for (int y = 0; y < lines; y++)
+                memcpy(dst + y * stride, origin + (y0 + y) * rowStride + x0, columns * sizeof(uint32_t));
+        }
+
+    int shift = 0;
+    while ((1 << shift) < TILE_SIZE)
+        shift++;
+    mAddressing.base = data;
+    mAddressing.shift = shift;
+    mAddressing.lastTileX = tilesX - 1;
+    mAddressing.lastTileY = tilesY - 1;
+    mAddressing.tileSize = tileSize;
+    mAddressing.stride = stride;
+    mAddressing.corner = mPadding * stride + mPadding;
+    mLayout = TILED;
+}
+
+IndexedPixels::IndexedPixels()
+{
+    _rowMajor(mAddressing, NULL, 0, 0);
+}
+
+IndexedPixels::IndexedPixels(const PixelBuffer& pixels)
+{
+    mAddressing = pixels.getAddressing();
+    mAddressing.base = NULL;
+    if (pixels.getStorageSize() == 0)
+        return;
+    //  colors of every pixel that can be addressed, the padding of tiles only repeats them
+    std::unique_ptr<_ColorTable> table(new _ColorTable());
+    int padding = pixels.getPadding();
+    uint32_t last = 0;
+    int lastIndex = -1;
+    for (int y = -padding; y < pixels.getHeight() + padding; y++)
+        for (int x = -padding; x < pixels.getWidth() + padding; x++)
+        {
+            uint32_t pixel = pixels.getPixel(x, y);
+            if (pixel == last && lastIndex >= 0)
+                continue;
+            int s = table->slot(pixel);
+            if (table->indices[s] < 0)
+            {
+                if (mColors.size() == 256)
+                {
+                    mColors.clear();
+                    return;
+                }
+                table->keys[s] = pixel;
+                table->indices[s] = (int)mColors.size();
+                mColors.push_back(pixel);
+            }
+            last = pixel;
+            lastIndex = table->indices[s];
+        }
+
+    std::vector<uint32_t> rgb(mColors.size());
+    for (size_t i = 0; i < mColors.size(); i++)
+        rgb[i] = mColors[i] & 0x00FFFFFF;
+    std::sort(rgb.begin(), rgb.end());
+    if (std::adjacent_find(rgb.begin(), rgb.end()) != rgb.end())
+    {
+        mColors.clear();
+        return;
+    }
+
+    //  the surplus pixels of the last tiles are never addressed and may hold other colors,
+    //  they get index 0
+    int size = pixels.getStorageSize();
+    const uint32_t* data = pixels.getAddressing().base;
+    mIndices = std::make_shared<std::vector<uint8_t> >(size);
+    uint8_t* indices = &(*mIndices)[0];
+    lastIndex = -1;
+    for (int i = 0; i < size; i++)
+    {
+        if (data[i] != last || lastIndex < 0)
+        {
+            int index = table->indices[table->slot(data[i])];
+            last = data[i];
+            lastIndex = std::max(index, 0);
+        }
+        indices[i] = static_cast<uint8_t>(lastIndex);
+    }
+}
+
+UniformBlocks::UniformBlocks()
+:   mFirst(0),
+    mEndX(0),
+    mEndY(0),
+    mBlocksX(0)
+{
+}
+
+UniformBlocks::UniformBlocks(const PixelBuffer& pixels, uint32_t mask)
+:   mFirst(-pixels.getPadding()),
+    mEndX(pixels.getWidth() + pixels.getPadding()),
+    mEndY(pixels.getHeight() + pixels.getPadding())
+{
+    assert(pixels.getPadding() <= BLOCK_SIZE);
+    if (pixels.getWidth() == 0 || pixels.getHeight() == 0)
+    {
+        mBlocksX = 0;
+        return;
+    }
+    mBlocksX = (mEndX - 1) / BLOCK_SIZE + 2;
+    int blocksY = (mEndY - 1) / BLOCK_SIZE + 2;
+    mColors.resize(mBlocksX * blocksY);
+    mUniform.resize(mBlocksX * blocksY, 1);
+    int left = mEndX;
+    int top = mEndY;
+    int right = mFirst;
+    int bottom = mFirst;
+
+    //  a block never straddles tiles, TILE_SIZE is a multiple of BLOCK_SIZE, so its pixels
+    //  on a row are next to each other in either layout
+    const PixelAddressing& addressing = pixels.getAddressing();
+    for (int y = mFirst; y < mEndY; y++)
+    {
+        int by = (y + BLOCK_SIZE) / BLOCK_SIZE;
+        bool firstRow = (y == mFirst || y % BLOCK_SIZE == 0);
+        for (int bx = 0; bx < mBlocksX; bx++)
+        {
+            int x0 = std::max((bx - 1) * BLOCK_SIZE, mFirst);
+            int x1 = std::min(bx * BLOCK_SIZE, mEndX);
+            if (x0 >= x1)
+                continue;
+            const uint32_t* p = addressing(x0, y);
+            int block = by * mBlocksX + bx;
+            if (firstRow)
+                mColors[block] = p[0] & mask;
+            uint32_t color = mColors[block];
+            for (int i = 0; i < x1 - x0; i++)
+            {
+                uint32_t c = p[i] & mask;
+                if (c != color)
+                    mUniform[block] = 0;
+                if (c != 0)
+                {
+                    left = std::min(left, x0 + i);
+                    right = std::max(right, x0 + i + 1);
+                    top = std::min(top, y);
+                    bottom = std::max(bottom, y + 1);
+                }
+            }
+        }
+    }
+    mContent = (left < right) ? Area(left, top, right, bottom) : Area(0, 0, 0, 0);
+}
+
+bool UniformBlocks::isUniform(int x0, int y0, int x1, int y1, uint32_t& color) const
+{
+    x0 = std::max(x0, mFirst);
+    y0 = std::max(y0, mFirst);
+    x1 = std::min(x1, mEndX - 1);
+    y1 = std::min(y1, mEndY - 1);
+    if (x0 > x1 || y0 > y1)
+        return false;
+    if (x1 < mContent.x1 || x0 >= mContent.x2 || y1 < mContent.y1 || y0 >= mContent.y2)
+    {
+        color = 0;
+        return true;
+    }
+
+    int bx0 = (x0 + BLOCK_SIZE) / BLOCK_SIZE;
+    int bx1 = (x1 + BLOCK_SIZE) / BLOCK_SIZE;
+    int by0 = (y0 + BLOCK_SIZE) / BLOCK_SIZE;
+    int by1 = (y1 + BLOCK_SIZE) / BLOCK_SIZE;
+    uint32_t first = mColors[by0 * mBlocksX + bx0];
+    for (int by = by0; by <= by1; by++)
+        for (int bx = bx0; bx <= bx1; bx++)
+        {
+            int block = by * mBlocksX + bx;
+            if (!mUniform[block] || mColors[block] != first)
+                return false;
+        }
+    color = first;
+    return true;
+}
+
+void pp::storeRow(Surface& dest, int x, int y, const uint32_t* pixels, int count)
+{
+    int inc = dest.getPixelInc();
+    uint8_t* dst = dest.getData() + y * dest.getRowBytes() + x * inc;
+    int r = dest.getRedOffset();
+    int g = dest.getGreenOffset();
+    int b = dest.getBlueOffset();
+    if (dest.hasAlpha())
+    {
+        int a = dest.getAlphaOffset();
+        for (int i = 0; i < count; i++, dst += inc)
+        {
+            uint32_t p = pixels[i];
+            dst[a] = 0xFF & (p >> 24);
+            dst[r] = 0xFF & (p >> 16);
+            dst[g] = 0xFF & (p >> 8);
+            dst[b] = 0xFF & p;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < count; i++, dst += inc)
+        {
+            uint32_t p = pixels[i];
+            dst[r] = 0xFF & (p >> 16);
+            dst[g] = 0xFF & (p >> 8);
+            dst[b] = 0xFF & p;
+        }
+    }
+}
+
+uint32_t pp::averagePixels(const uint32_t* pixels, int count, bool alpha)
+{
+    uint32_t sum[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t p = pixels[i];
+        uint32_t weight = alpha ? (p >> 24) : 1;
+        sum[0] += weight * (0xFF & p);
+        sum[1] += weight * (0xFF & (p >> 8));
+        sum[2] += weight * (0xFF & (p >> 16));
+        sum[3] += p >> 24;
+    }
+    uint32_t total = alpha ? sum[3] : count;
+    if (total == 0)
+        return 0;
+    uint32_t b = (sum[0] + total / 2) / total;
+    uint32_t g = (sum[1] + total / 2) / total;
+    uint32_t r = (sum[2] + total / 2) / total;
+    uint32_t a = (sum[3] + count / 2) / count;
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+MipPyramid::MipPyramid(const PixelBuffer& base)
+:   mBuilt(1),
+    mLevelCount(1)
+{
+    for (int size = std::max(base.getWidth(), base.getHeight()); size > 1; size = (size + 1) / 2)
+        mLevelCount++;
+    mLevels.reserve(mLevelCount);
+    mLevels.push_back(base);
+}
+
+const PixelBuffer& MipPyramid::getLevel(int k)
+{
+    k = std::min(k, mLevelCount - 1);
+    if (k < mBuilt.load(std::memory_order_acquire))
+        return mLevels[k];
+
+    std::lock_guard<std::mutex> guard(mBuildLock);
+    while ((int)mLevels.size() <= k)
+    {
+        //  each pixel averages 2x2 of the level below, odd sizes round up and reuse the
+        //  clamped last row/column
+        const PixelBuffer& below = mLevels.back();
+        int width = (below.getWidth() + 1) / 2;
+        int height = (below.getHeight() + 1) / 2;
+        int stride = below.getStride();
+        PixelBuffer level(width, height, 1);
+        for (int y = 0; y < height; y++)
+        {
+            const uint32_t* src = below.getRow(2 * y);
+            uint32_t* dst = level.getRow(y);
+            for (int x = 0; x < width; x++)
+            {
+                const uint32_t* p = src + 2 * x;
+                uint32_t quad[4] = { p[0], p[1], p[stride], p[stride+1] };
+                dst[x] = averagePixels(quad, 4, true);
+            }
+        }
+        level.fillPadding();
+        mLevels.push_back(level);
+    }
+    mBuilt.store((int)mLevels.size(), std::memory_order_release);
+    return mLevels[k];
+}
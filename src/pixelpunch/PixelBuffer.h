@@ -0,0 +1,177 @@
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/Surface.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pp
+{
+    // Pixels are packed as 0xAARRGGBB, the layout Kernel uses for RGB.
+    inline uint32_t packPixel(const ci::ColorA8u& c)
+    {
+        return (uint32_t(c.a) << 24) | (uint32_t(c.r) << 16) | (uint32_t(c.g) << 8) | uint32_t(c.b);
+    }
+
+    inline ci::ColorA8u unpackPixel(uint32_t p)
+    {
+        return ci::ColorA8u(0xFF & (p >> 16), 0xFF & (p >> 8), 0xFF & p, 0xFF & (p >> 24));
+    }
+
+    // Address arithmetic of a PixelBuffer in either layout: pixel (x, y) lives at
+    // base + offset(x, y) for x, y anywhere within the padding, and its neighbours up to the
+    // padding away at +-1 and +-stride. Coordinates pick the nearest tile, the padding of
+    // the tile covers the rest. Row-major buffers are a single tile (shift 31), so one
+    // formula serves both.
+    struct PixelAddressing
+    {
+        const uint32_t* base;
+        int shift;      // log2 of the tile size
+        int lastTileX;  // tiles per row - 1
+        int lastTileY;  // tiles per column - 1
+        int tileSize;   // pixels per padded tile
+        int stride;     // row pitch, within a tile when tiled
+        int corner;     // offset of the first inner pixel of a tile
+
+        int offset(int x, int y) const
+        {
+            int tx = std::min(std::max(x, 0) >> shift, lastTileX);
+            int ty = std::min(std::max(y, 0) >> shift, lastTileY);
+            return (ty * (lastTileX + 1) + tx) * tileSize + (y - (ty << shift)) * stride + (x - (tx << shift)) + corner;
+        }
+        const uint32_t* operator()(int x, int y) const { return base + offset(x, y); }
+    };
+
+    // Packed copy of a Surface surrounded by 'padding' pixels of border. Samplers read their
+    // whole footprint through raw pointers without per-pixel bounds checks as long as they
+    // stay within the padding. Copies share the pixel data, like ci::Surface.
+    //
+    // The border repeats the edge pixels (CLAMP), is blank (TRANSPARENT), continues with the
+    // opposite edge as for tileable textures (WRAP) or reflects the image at its edges,
+    // the edge pixel included (MIRROR).
+    //
+    // TILED stores the image as TILE_SIZE squares, each with its own padding holding the
+    // neighbouring pixels, so a footprint never straddles tiles and samples walking the
+    // source at an angle stay within a few cache lines. Only ROW_MAJOR buffers have rows.
+    class PixelBuffer
+    {
+     public:
+        enum Layout { ROW_MAJOR, TILED };
+        enum Border { BORDER_CLAMP, BORDER_TRANSPARENT, BORDER_WRAP, BORDER_MIRROR };
+        static const int TILE_SIZE = 32;
+
+        PixelBuffer();
+        PixelBuffer(const ci::Surface& source, int padding, Layout layout = ROW_MAJOR, Border border = BORDER_CLAMP);
+        PixelBuffer(int width, int height, int padding);  // blank, fill the rows then fillPadding()
+
+        int getWidth() const { return mWidth; }
+        int getHeight() const { return mHeight; }
+        int getPadding() const { return mPadding; }
+        int getStride() const { return mAddressing.stride; }  // in pixels
+        Layout getLayout() const { return mLayout; }
+        Border getBorder() const { return mBorder; }
+        const PixelAddressing& getAddressing() const { return mAddressing; }
+        uint32_t getPixel(int x, int y) const { return *mAddressing(x, y); }
+        // pixels from getAddressing().base on, padding, tiles and their surplus included
+        int getStorageSize() const { return mData ? (int)mData->size() : 0; }
+
+        // ROW_MAJOR only
+        const uint32_t* getOrigin() const { return mAddressing.base + mAddressing.corner; }  // pixel (0, 0)
+        const uint32_t* getRow(int y) const { return getOrigin() + y * mAddressing.stride; }
+        uint32_t* getRow(int y) { return &(*mData)[0] + mAddressing.corner + y * mAddressing.stride; }
+
+        // fills the padding from the inner pixels, ROW_MAJOR only
+        void fillPadding(Border border = BORDER_CLAMP);
+        // writes an inner pixel and the padding pixels showing it, ROW_MAJOR only
+        void setPixel(int x, int y, uint32_t pixel);
+
+     private:
+        void tile();
+
+        std::shared_ptr<std::vector<uint32_t> > mData;
+        PixelAddressing mAddressing;
+        Layout mLayout;
+        Border mBorder;
+        int mWidth;
+        int mHeight;
+        int mPadding;
+    };
+
+    // A PixelBuffer of at most 256 colors as bytes: every pixel of its storage replaced by the
+    // index of its color, at the same offset, so the index of pixel (x, y) is at getBase() +
+    // getAddressing().offset(x, y) and its neighbours at +-1 and +-stride. Colors differing
+    // only in alpha would make equal indices mean something else than equal RGB, buffers
+    // holding such are not indexed either. Copies share the indices.
+    class IndexedPixels
+    {
+     public:
+        IndexedPixels();
+        explicit IndexedPixels(const PixelBuffer& pixels);  // empty() if pixels can not be indexed
+
+        bool empty() const { return !mIndices; }
+        int getColorCount() const { return (int)mColors.size(); }
+        const PixelAddressing& getAddressing() const { return mAddressing; }  // of the buffer, without base
+        const uint8_t* getBase() const { return &(*mIndices)[0]; }
+        uint32_t getColor(uint8_t index) const { return mColors[index]; }  // packed
+
+     private:
+        std::shared_ptr<std::vector<uint8_t> > mIndices;
+        std::vector<uint32_t> mColors;
+        PixelAddressing mAddressing;
+    };
+
+    // Which BLOCK_SIZE squares of a PixelBuffer, aligned to pixel (0, 0) and taking in the
+    // padding, hold a single color, and the bounds of the pixels that are not blank, so that
+    // a region can be found to be one color without looking at its pixels. Pixels are
+    // compared under mask. Describes the buffer as it was when built.
+    class UniformBlocks
+    {
+     public:
+        static const int BLOCK_SIZE = 8;
+
+        UniformBlocks();
+        explicit UniformBlocks(const PixelBuffer& pixels, uint32_t mask = 0xFFFFFFFF);
+
+        // true if all pixels of [x0, x1] x [y0, y1] within the buffer and its padding have
+        // one color under the mask, which goes to color; false for regions without pixels
+        bool isUniform(int x0, int y0, int x1, int y1, uint32_t& color) const;
+        // pixels outside are blank under the mask, padding included; empty if all of them are
+        const ci::Area& getContentBounds() const { return mContent; }
+
+     private:
+        int mFirst;         // first coordinate in x and y, -padding
+        int mEndX;          // past the last ones
+        int mEndY;
+        int mBlocksX;       // block (bx, by) holds the pixels from (bx - 1, by - 1) * BLOCK_SIZE on
+        std::vector<uint32_t> mColors;      // of the first pixel of each block, under the mask
+        std::vector<uint8_t> mUniform;
+        ci::Area mContent;
+    };
+
+    // Writes 'count' packed pixels into row y of dest, starting at column x.
+    void storeRow(ci::Surface& dest, int x, int y, const uint32_t* pixels, int count);
+
+    // Rounded average of count packed pixels; with alpha the colors are weighted by it.
+    uint32_t averagePixels(const uint32_t* pixels, int count, bool alpha);
+
+    // Mip levels of a PixelBuffer, each half the size of the one before and padded by 1.
+    // Levels are built on first request, requests may come from several threads at once.
+    class MipPyramid
+    {
+     public:
+        explicit MipPyramid(const PixelBuffer& base);
+
+        // level k, or the last (1x1) level if k is beyond it
+        const PixelBuffer& getLevel(int k);
+        int getLevelCount() const { return mLevelCount; }  // levels possible, not levels built
+
+     private:
+        std::vector<PixelBuffer> mLevels;   // reserved up front so built levels never move
+        std::atomic<int> mBuilt;
+        std::mutex mBuildLock;
+        int mLevelCount;
+    };
+}  // namespace pp
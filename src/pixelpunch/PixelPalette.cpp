@@ -0,0 +1,113 @@
+#include "PixelPalette.h"
+#include "PixelBuffer.h"
+#include <algorithm>
+#include <limits>
+
+using namespace cinder;
+using namespace pp;
+
+namespace
+{
+    const int CELL_BITS = 3;                    // 8 values per channel and cell
+    const int CELL_SIZE = 1 << CELL_BITS;
+    const int CELLS = 256 >> CELL_BITS;         // cells per channel
+
+    inline int _channel(uint32_t p, int shift)
+    {
+        return 0xFF & (p >> shift);
+    }
+
+    //  squared distance from v to the nearest and farthest value of [lo, lo + CELL_SIZE - 1]
+    inline void _spanDistance(int v, int lo, int& nearest, int& farthest)
+    {
+        int hi = lo + CELL_SIZE - 1;
+        int d = (v < lo) ? lo - v : (v > hi) ? v - hi : 0;
+        int f = std::max(v - lo, hi - v);
+        nearest = d * d;
+        farthest = f * f;
+    }
+}
+
+PaletteIndex::PaletteIndex()
+{
+}
+
+PaletteIndex::PaletteIndex(const Palette& colors)
+{
+    mColors.reserve(colors.size());
+    for (Palette::const_iterator it = colors.begin(); it != colors.end(); it++)
+        mColors.push_back(packPixel(ColorA8u(it->r, it->g, it->b)));
+    mCells.reset(new std::atomic<const int*>[CELLS * CELLS * CELLS]);
+    for (int i = 0; i < CELLS * CELLS * CELLS; i++)
+        mCells[i].store(NULL);
+}
+
+const int* PaletteIndex::fillCell(int cell)
+{
+    std::lock_guard<std::mutex> guard(mFillLock);
+    const int* filled = mCells[cell].load(std::memory_order_acquire);
+    if (filled)
+        return filled;
+
+    int lr = (cell / (CELLS * CELLS)) * CELL_SIZE;
+    int lg = ((cell / CELLS) % CELLS) * CELL_SIZE;
+    int lb = (cell % CELLS) * CELL_SIZE;
+
+    //  no point of the cell is farther than 'bound' from its nearest color, so every color
+    //  whose distance to the cell is within 'bound' is a candidate
+    int count = size();
+    std::vector<int> nearDistance(count);
+    int bound = std::numeric_limits<int>::max();
+    for (int i = 0; i < count; i++)
+    {
+        int nr, ng, nb, fr, fg, fb;
+        _spanDistance(_channel(mColors[i], 16), lr, nr, fr);
+        _spanDistance(_channel(mColors[i], 8), lg, ng, fg);
+        _spanDistance(_channel(mColors[i], 0), lb, nb, fb);
+        nearDistance[i] = nr + ng + nb;
+        bound = std::min(bound, fr + fg + fb);
+    }
+
+    mCandidates.push_back(std::vector<int>(1, 0));
+    std::vector<int>& candidates = mCandidates.back();
+    for (int i = 0; i < count; i++)
+        if (nearDistance[i] <= bound)
+            candidates.push_back(i);
+    candidates[0] = (int)candidates.size() - 1;
+    mCells[cell].store(&candidates[0], std::memory_order_release);
+    return &candidates[0];
+}
+
+uint32_t PaletteIndex::nearest(int r, int g, int b)
+{
+    if (mColors.empty())
+        return 0;
+
+    int cell = ((r >> CELL_BITS) * CELLS + (g >> CELL_BITS)) * CELLS + (b >> CELL_BITS);
+    const int* candidates = mCells[cell].load(std::memory_order_acquire);
+    if (!candidates)
+        candidates = fillCell(cell);
+
+    int count = candidates[0];
+    if (count == 1)
+        return mColors[candidates[1]];
+
+    int best = std::numeric_limits<int>::max();
+    uint32_t result = 0;
+    for (int i = 1; i <= count; i++)
+    {
+        uint32_t p = mColors[candidates[i]];
+        int dr = _channel(p, 16) - r;
+        int dg = _channel(p, 8) - g;
+        int db = _channel(p, 0) - b;
+        int error = dr*dr + dg*dg + db*db;
+        if (error < best)
+        {
+            result = p;
+            best = error;
+            if (error == 0)
+                break;
+        }
+    }
+    return result;
+}
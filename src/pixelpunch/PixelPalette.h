@@ -0,0 +1,39 @@
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "PixelPunch.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pp
+{
+    // Nearest color lookup into a fixed palette. The RGB cube is split into 32x32x32 cells;
+    // the first lookup inside a cell collects every palette color that can be the nearest one
+    // for some point of that cell, later lookups only scan those few candidates. Results are
+    // exactly those of a linear scan, ties go to the color that comes first in the palette.
+    // Lookups may run concurrently, filling a cell is serialized.
+    class PaletteIndex
+    {
+     public:
+        PaletteIndex();
+        explicit PaletteIndex(const Palette& colors);
+
+        bool empty() const { return mColors.empty(); }
+        int size() const { return (int)mColors.size(); }
+        const uint32_t* colors() const { return mColors.empty() ? NULL : &mColors[0]; }  // packed, palette order
+
+        // nearest packed color for r, g, b in 0..255, 0 if the palette is empty
+        uint32_t nearest(int r, int g, int b);
+
+     private:
+        const int* fillCell(int cell);
+
+        std::vector<uint32_t> mColors;
+        std::unique_ptr<std::atomic<const int*>[]> mCells;  // per cell: count followed by palette indices, NULL until first used
+        std::deque<std::vector<int> > mCandidates;         // storage of the cell lists
+        std::mutex mFillLock;
+    };
+}  // namespace pp
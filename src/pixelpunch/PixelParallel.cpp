@@ -0,0 +1,199 @@
+#include "PixelParallel.h"
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace pp;
+
+namespace
+{
+    //  the indices a worker has left, [begin, end)
+    struct _Share
+    {
+        std::mutex lock;
+        int begin;
+        int end;
+    };
+
+    bool _take(_Share& share, int& index)
+    {
+        std::lock_guard<std::mutex> guard(share.lock);
+        if (share.begin >= share.end)
+            return false;
+        index = share.begin++;
+        return true;
+    }
+
+    //  moves the upper half of the largest other share into own, false if there is no work left
+    bool _steal(_Share* shares, int workers, int self)
+    {
+        while (true)
+        {
+            int victim = -1;
+            int most = 0;
+            for (int i = 0; i < workers; i++)
+            {
+                if (i == self)
+                    continue;
+                std::lock_guard<std::mutex> guard(shares[i].lock);
+                int left = shares[i].end - shares[i].begin;
+                if (left > most)
+                {
+                    most = left;
+                    victim = i;
+                }
+            }
+            if (victim < 0)
+                return false;
+
+            int begin, end;
+            {
+                std::lock_guard<std::mutex> guard(shares[victim].lock);
+                int left = shares[victim].end - shares[victim].begin;
+                if (left <= 0)
+                    continue;  // emptied meanwhile, look again
+                end = shares[victim].end;
+                begin = end - (left + 1) / 2;
+                shares[victim].end = begin;
+            }
+            std::lock_guard<std::mutex> guard(shares[self].lock);
+            shares[self].begin = begin;
+            shares[self].end = end;
+            return true;
+        }
+    }
+
+    //  threads running tasks right now, parallelFor from one of them stays on it
+    std::mutex sWorkersLock;
+    std::vector<std::thread::id> sWorkers;
+
+    struct _Worker
+    {
+        _Worker()
+        {
+            std::lock_guard<std::mutex> guard(sWorkersLock);
+            sWorkers.push_back(std::this_thread::get_id());
+        }
+        ~_Worker()
+        {
+            std::lock_guard<std::mutex> guard(sWorkersLock);
+            sWorkers.erase(std::find(sWorkers.begin(), sWorkers.end(), std::this_thread::get_id()));
+        }
+    };
+
+    bool _isWorker()
+    {
+        std::lock_guard<std::mutex> guard(sWorkersLock);
+        return std::find(sWorkers.begin(), sWorkers.end(), std::this_thread::get_id()) != sWorkers.end();
+    }
+
+    void _work(_Share* shares, int workers, int self, const std::function<void(int)>& task)
+    {
+        int index;
+        do
+        {
+            while (_take(shares[self], index))
+                task(index);
+        } while (_steal(shares, workers, self));
+    }
+
+    //  threads started on first use that stay for the life of the process, one less than
+    //  there are cores since the calling thread works too. They are never joined, joining
+    //  from a static destructor can hang on exit
+    class _Pool
+    {
+    public:
+        explicit _Pool(int threads) : mGeneration(0), mPending(0), mShares(nullptr), mWorkers(0), mTask(nullptr)
+        {
+            for (int i = 1; i <= threads; i++)
+                std::thread(&_Pool::serve, this, i).detach();
+        }
+
+        //  runs the shares on the calling thread as worker 0 and on pool threads 1 to workers - 1
+        void run(_Share* shares, int workers, const std::function<void(int)>& task)
+        {
+            std::lock_guard<std::mutex> serial(mRunLock);
+            {
+                std::lock_guard<std::mutex> guard(mLock);
+                mShares = shares;
+                mWorkers = workers;
+                mTask = &task;
+                mPending = workers - 1;
+                mGeneration++;
+            }
+            mWake.notify_all();
+            {
+                _Worker worker;
+                _work(shares, workers, 0, task);
+            }
+            std::unique_lock<std::mutex> guard(mLock);
+            mDone.wait(guard, [this] { return mPending == 0; });
+        }
+
+    private:
+        void serve(int self)
+        {
+            _Worker worker;
+            unsigned seen = 0;
+            std::unique_lock<std::mutex> guard(mLock);
+            while (true)
+            {
+                mWake.wait(guard, [&] { return mGeneration != seen; });
+                seen = mGeneration;
+                if (self >= mWorkers)
+                    continue;
+                _Share* shares = mShares;
+                int workers = mWorkers;
+                const std::function<void(int)>* task = mTask;
+                guard.unlock();
+                _work(shares, workers, self, *task);
+                guard.lock();
+                if (--mPending == 0)
+                    mDone.notify_one();
+            }
+        }
+
+        std::mutex mRunLock;  // one parallelFor at a time
+        std::mutex mLock;
+        std::condition_variable mWake;
+        std::condition_variable mDone;
+        unsigned mGeneration;
+        int mPending;
+        _Share* mShares;
+        int mWorkers;
+        const std::function<void(int)>* mTask;
+    };
+
+    std::mutex sPoolLock;
+    _Pool* sPool = nullptr;
+
+    _Pool& _pool()
+    {
+        std::lock_guard<std::mutex> guard(sPoolLock);
+        if (!sPool)
+            sPool = new _Pool((int)std::thread::hardware_concurrency() - 1);
+        return *sPool;
+    }
+}
+
+void pp::parallelFor(int count, const std::function<void(int)>& task)
+{
+    int workers = std::min((int)std::thread::hardware_concurrency(), count);
+    if (workers <= 1 || _isWorker())
+    {
+        for (int i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+
+    std::unique_ptr<_Share[]> shares(new _Share[workers]);
+    for (int i = 0; i < workers; i++)
+    {
+        shares[i].begin = i * count / workers;
+        shares[i].end = (i + 1) * count / workers;
+    }
+    _pool().run(shares.get(), workers, task);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <functional>
+
+namespace pp
+{
+    // Runs task(i) for every i in [0, count) on all cores and returns when all are done.
+    // Each worker starts on its own contiguous share of the indices; a worker that runs out
+    // steals the upper half of the largest share left, so uneven tasks even out.
+    // task must be safe to call concurrently for different indices. Called from inside a
+    // task it runs the indices one after the other on that thread, the cores are busy already.
+    void parallelFor(int count, const std::function<void(int)>& task);
+}  // namespace pp
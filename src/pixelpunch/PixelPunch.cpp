@@ -1,6 +1,14 @@
 #include "PixelPunch.h"
+#include "PixelBuffer.h"
+#include "PixelParallel.h"
+#include "PixelSimd.h"
 #include "Kernel.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
 
 using namespace cinder;
 
@@ -12,105 +20,391 @@ void pp::genDest(Surface& source, int scaleFactor, Surface& result)
     result = Surface(w, h, alpha);
 }
 
+namespace
+{
+    const uint32_t EMPTY_COLOR = 0xFFFFFFFF;  // no packed RGB value has the top byte set
+
+    //  open addressing hash set on packed RGB, remembering how often each color occurs and
+    //  its first position in column-major order
+    struct _ColorTable
+    {
+        struct Entry
+        {
+            uint32_t color;
+            int count;
+            int first;
+        };
+
+        _ColorTable() : entries(64, Entry{EMPTY_COLOR, 0, 0}), size(0) {}
+
+        void add(uint32_t color, int count, int first)
+        {
+            if (2 * (size + 1) > (int)entries.size())
+                grow();
+            Entry& e = find(color);
+            if (e.color == EMPTY_COLOR)
+            {
+                e.color = color;
+                e.count = count;
+                e.first = first;
+                size++;
+            }
+            else
+            {
+                e.count += count;
+                e.first = std::min(e.first, first);
+            }
+        }
+
+        Entry& find(uint32_t color)
+        {
+            uint32_t mask = (uint32_t)entries.size() - 1;
+            uint32_t i = color * 2654435761u;
+            i = (i ^ (i >> 15)) & mask;
+            while (entries[i].color != EMPTY_COLOR && entries[i].color != color)
+                i = (i + 1) & mask;
+            return entries[i];
+        }
+
+        void grow()
+        {
+            std::vector<Entry> old(2 * entries.size(), Entry{EMPTY_COLOR, 0, 0});
+            old.swap(entries);
+            for (size_t i = 0; i < old.size(); i++)
+                if (old[i].color != EMPTY_COLOR)
+                    find(old[i].color) = old[i];
+        }
+
+        std::vector<Entry> entries;
+        int size;
+    };
+
+    void _countColors(const pp::PixelBuffer& pixels, int fromY, int toY, _ColorTable& table)
+    {
+        int width = pixels.getWidth();
+        int height = pixels.getHeight();
+        for (int y = fromY; y < toY; y++)
+        {
+            const uint32_t* row = pixels.getRow(y);
+            int x = 0;
+            while (x < width)
+            {
+                //  runs of the same color only cost one lookup
+                uint32_t color = row[x] & 0xFFFFFF;
+                int start = x;
+                while (x < width && (row[x] & 0xFFFFFF) == color)
+                    x++;
+                table.add(color, x - start, start * height + y);
+            }
+        }
+    }
+
+    bool _firstSeen(const _ColorTable::Entry& a, const _ColorTable::Entry& b)
+    {
+        return a.first < b.first;
+    }
+}
+
 void pp::getColors(cinder::Surface& source, Palette& result)
+{
+    std::vector<int> frequencies;
+    getColors(source, result, frequencies);
+}
+
+void pp::getColors(cinder::Surface& source, Palette& result, std::vector<int>& frequencies)
 {
     result.clear();
-    ivec2 v(0, 0);
-    int width = source.getWidth();
-    int height = source.getHeight();
-    for (v.x = 0; v.x < width; v.x++)
-        for (v.y = 0; v.y < height; v.y++)
+    frequencies.clear();
+    pp::PixelBuffer pixels(source, 0);
+    int height = pixels.getHeight();
+
+    //  count bands of rows in parallel, then merge their tables
+    int bands = 1;
+    if (pixels.getWidth() * height >= 256 * 256)
+        bands = std::max(1, std::min((int)std::thread::hardware_concurrency(), height));
+    std::vector<_ColorTable> tables(bands);
+    parallelFor(bands, [&](int i)
+    {
+        _countColors(pixels, i * height / bands, (i + 1) * height / bands, tables[i]);
+    });
+
+    _ColorTable& table = tables[0];
+    for (int i = 1; i < bands; i++)
+        for (size_t j = 0; j < tables[i].entries.size(); j++)
         {
-            Color8u pxl = source.getPixel(v);
-            bool found = false;
-            for (Palette::iterator it = result.begin(); it != result.end(); it++)
-                if (distance2(Color8u(it->r, it->g, it->b), pxl) == 0)  // found
-                    found = true;
-            if (!found)
-                result.push_back(pxl);
+            const _ColorTable::Entry& e = tables[i].entries[j];
+            if (e.color != EMPTY_COLOR)
+                table.add(e.color, e.count, e.first);
         }
+
+    std::vector<_ColorTable::Entry> colors;
+    colors.reserve(table.size);
+    for (size_t i = 0; i < table.entries.size(); i++)
+        if (table.entries[i].color != EMPTY_COLOR)
+            colors.push_back(table.entries[i]);
+    std::sort(colors.begin(), colors.end(), _firstSeen);
+
+    result.reserve(colors.size());
+    frequencies.reserve(colors.size());
+    for (size_t i = 0; i < colors.size(); i++)
+    {
+        uint32_t c = colors[i].color;
+        result.push_back(Color8u(0xFF & (c >> 16), 0xFF & (c >> 8), 0xFF & c));
+        frequencies.push_back(colors[i].count);
+    }
 }
 
-Surface pp::compare(Surface& imageA, Surface& imageB)
+//  the float filter compare() was defined with. A channel whose integer result is a whole
+//  number is decided here, the float sum can land just below it depending on the taps.
+uint32_t _compareFloat(const uint32_t* const* rowsA, const uint32_t* const* rowsB, int x)
 {
-    // for each target pixel find one in source!
-    float width = std::min(imageA.getWidth(), imageB.getWidth());
-    float height = std::min(imageB.getHeight(), imageB.getHeight());
-
     float kernel[3][3] = {{0.0625, 0.125, 0.0625}, {0.125, 0.25, 0.125}, {0.0625, 0.125, 0.0625}};
-    Surface result(width, height, false);
-    ivec2 v(0, 0);
-    for (v.x = 0; v.x < width; v.x++)
-        for (v.y = 0; v.y < height; v.y++)
+    float c[3] = {0.5, 0.5, 0.5};
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
         {
-            float c[3] = {0.5, 0.5, 0.5};
-            for (int i = 0; i < 3; i++)
-                for (int j = 0; j < 3; j++)
-                {
-                    ivec2 offset(i-1, j-1);
-                    Color8u a = imageA.getPixel(v+offset);
-                    Color8u b = imageB.getPixel(v+offset);
-                    for (int k = 0; k < 3; k++)
-                        c[k] += kernel[i][j] * (a[k]-b[k])/255.0f;
-                }
-                result.setPixel(v, Color8u(c[0]*255, c[1]*255, c[2]*255));
+            uint32_t a = rowsA[j][x+i-1];
+            uint32_t b = rowsB[j][x+i-1];
+            for (int k = 0; k < 3; k++)
+            {
+                int shift = 16 - 8 * k;  // r, g, b
+                int diff = int(0xFF & (a >> shift)) - int(0xFF & (b >> shift));
+                c[k] += kernel[i][j] * diff/255.0f;
+            }
         }
-    /*
-    Surface result(width, height, false);
-    Vec2i v(0,0);
-    for(v.x = 0; v.x < width; v.x++)
-        for(v.y = 0; v.y < height; v.y++)
+    // values outside 0..255 wrap around, as the conversion to Color8u always did
+    uint32_t result = 0xFF000000;
+    for (int k = 0; k < 3; k++)
+        result |= (0xFF & static_cast<uint32_t>(static_cast<int>(c[k]*255))) << (16 - 8 * k);
+    return result;
+}
+
+//  With S the [1 2 1] x [1 2 1] sum of the channel differences a channel is
+//  (int)(127.5 + S / 16) = (2040 + S) / 16 rounded towards zero. The vertical pass sums
+//  the differences of the three lines per column, the horizontal one weights three columns.
+void pp::compareRow(const uint32_t* const* rowsA, const uint32_t* const* rowsB, int width, uint32_t* out)
+{
+    //  columns -1..width as 16 bit channels in packed order, one more so pairs can be read
+    std::vector<int16_t> columns(4 * (width + 3));
+    int16_t* column = &columns[0];
+#if defined(PP_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (int x = -1; x <= width; x += 2)
+    {
+        __m128i sum = zero;
+        for (int j = 0; j < 3; j++)
         {
-            Color8u a = imageA.getPixel(v);
-            Color8u b = imageB.getPixel(v);
-            float c[3] = {0.5,0.5,0.5};
-            for(int k = 0; k < 3; k++)
-                c[k] += (a[k]-b[k])/255.0f;
-            result.setPixel(v,Color8u(c[0]*127,c[1]*127,c[2]*127));
+            __m128i a, b;
+            if (x < width)
+            {
+                a = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rowsA[j] + x));
+                b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rowsB[j] + x));
+            }
+            else
+            {
+                a = _mm_cvtsi32_si128(rowsA[j][x]);
+                b = _mm_cvtsi32_si128(rowsB[j][x]);
+            }
+            __m128i diff = _mm_sub_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            sum = _mm_add_epi16(sum, (j == 1) ? _mm_slli_epi16(diff, 1) : diff);
         }
-    */
-    return result;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(column + 4 * (x + 1)), sum);
+    }
+
+    const __m128i bias = _mm_set1_epi16(2040);
+    const __m128i fifteen = _mm_set1_epi16(15);
+    const __m128i low = _mm_set1_epi16(0xFF);
+    const int colorBytes = 0x3F3F;    // movemask bits of b, g, r of both pixels
+    for (int x = 0; x < width; x += 2)
+    {
+        __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + 4 * x));
+        __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + 4 * (x + 1)));
+        __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + 4 * (x + 2)));
+        __m128i n = _mm_add_epi16(_mm_add_epi16(left, right), _mm_add_epi16(_mm_slli_epi16(center, 1), bias));
+        __m128i truncated = _mm_srai_epi16(_mm_add_epi16(n, _mm_and_si128(_mm_srai_epi16(n, 15), fifteen)), 4);
+        __m128i bytes = _mm_packus_epi16(_mm_and_si128(truncated, low), zero);
+        uint32_t pair[2];
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(pair), bytes);
+        int whole = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(n, fifteen), zero)) & colorBytes;
+        for (int k = 0; k < 2 && x + k < width; k++)
+            out[x + k] = ((whole >> (8 * k)) & 0x3F) ? _compareFloat(rowsA, rowsB, x + k) : (0xFF000000 | pair[k]);
+    }
+#else
+    for (int x = -1; x <= width; x++)
+        for (int k = 0; k < 4; k++)
+        {
+            int shift = 8 * k;
+            int sum = 0;
+            for (int j = 0; j < 3; j++)
+            {
+                int diff = int(0xFF & (rowsA[j][x] >> shift)) - int(0xFF & (rowsB[j][x] >> shift));
+                sum += (j == 1) ? 2 * diff : diff;
+            }
+            column[4 * (x + 1) + k] = (int16_t)sum;
+        }
+
+    for (int x = 0; x < width; x++)
+    {
+        uint32_t result = 0xFF000000;
+        bool whole = false;
+        for (int k = 0; k < 3; k++)
+        {
+            int n = 2040 + column[4 * x + k] + 2 * column[4 * (x + 1) + k] + column[4 * (x + 2) + k];
+            whole = whole || (n & 15) == 0;
+            result |= (0xFF & static_cast<uint32_t>(n < 0 ? -(-n >> 4) : n >> 4)) << (8 * k);
+        }
+        out[x] = whole ? _compareFloat(rowsA, rowsB, x) : result;
+    }
+#endif
 }
 
-Surface pp::choose(cinder::Surface& imageA, cinder::Surface& imageB, cinder::Surface& errorA, cinder::Surface& secondWeight, float threshold)
+void pp::errorRow(const uint32_t* compareRow, int width, int* out)
+{
+    for (int x = 0; x < width; x++)
+    {
+        int r = int(0xFF & (compareRow[x] >> 16)) - 127;
+        int g = int(0xFF & (compareRow[x] >> 8)) - 127;
+        int b = int(0xFF & compareRow[x]) - 127;
+        out[x] = r*r + g*g + b*b;
+    }
+}
+
+void pp::scoreRow(const int* const* errorRows, const uint32_t* secondWeight, int width, float* out)
+{
+    for (int x = 0; x < width; x++)
+    {
+        // is errorA a local maximum?
+        bool swap = true;
+        float errA = errorRows[1][x];
+        for (int i = 0; i < 3 && swap; i++)
+            for (int j = 0; j < 3 && swap; j++)
+                if (i != 1 || j != 1)
+                {
+                    float errOther = errorRows[j][x+i-1];
+                    if (errOther >= errA)
+                        swap = false;
+                }
+        float alternative = 0xFF & (secondWeight[x] >> 16);
+        out[x] = swap ? std::sqrt(errA)*alternative : -std::numeric_limits<float>::infinity();
+    }
+}
+
+void pp::selectRow(const uint32_t* imageA, const uint32_t* imageB, const float* scores, int width, float threshold, uint32_t* out)
+{
+    float limit = threshold*(3*127*127);
+    for (int x = 0; x < width; x++)
+        out[x] = scores[x] > limit ? imageB[x] : imageA[x];
+}
+
+void pp::chooseRow(const uint32_t* imageA, const uint32_t* imageB, const int* const* errorRows, const uint32_t* secondWeight,
+                   int width, float threshold, uint32_t* out)
+{
+    std::vector<float> scores(width);
+    scoreRow(errorRows, secondWeight, width, &scores[0]);
+    selectRow(imageA, imageB, &scores[0], width, threshold, out);
+}
+
+Surface pp::compare(Surface& imageA, Surface& imageB)
 {
-    // for each target pixel find one in source!
-    float width = std::min(imageA.getWidth(), imageB.getWidth());
-    float height = std::min(imageB.getHeight(), imageB.getHeight());
+    int width = std::min(imageA.getWidth(), imageB.getWidth());
+    int height = std::min(imageA.getHeight(), imageB.getHeight());
 
+    PixelBuffer a(imageA, 1);
+    PixelBuffer b(imageB, 1);
     Surface result(width, height, false);
-    ivec2 v(0, 0);
-    for (v.y = 0; v.y < height; v.y++)
-        for (v.x = 0; v.x < width; v.x++)
+
+    //  bands of lines in parallel, each writing its own lines
+    int bands = 1;
+    if (width * height >= 256 * 256)
+        bands = std::max(1, std::min((int)std::thread::hardware_concurrency(), height));
+    parallelFor(bands, [&](int i)
+    {
+        std::vector<uint32_t> row(width);
+        for (int y = i * height / bands; y < (i + 1) * height / bands; y++)
         {
-            // is errorA a local maximum?
-            bool swap = true;
-            Color8u eA = errorA.getPixel(v);
-            float errA = (eA.r-127)*(eA.r-127) + (eA.g-127)*(eA.g-127) + (eA.b-127)*(eA.b-127);
-            float alternative = secondWeight.getPixel(v).r;
-            if (std::sqrt(errA)*alternative <= threshold*(3*127*127))
-                swap = false;
-            else
-                for (int i = 0; i < 3 && swap; i++)
-                    for (int j = 0; j < 3 && swap; j++)
-                        if (i != 1 || j != 1)
-                        {
-                            ivec2 offset(i-1, j-1);
-                            Color8u eO = errorA.getPixel(v+offset);
-                            float errOther = (eO.r-127)*(eO.r-127) + (eO.g-127)*(eO.g-127) + (eO.b-127)*(eO.b-127);
-                            if (errOther >= errA)
-                                swap = false;
-                        }
-
-            if (swap)
-                result.setPixel(v, imageB.getPixel(v));
-            else
-                result.setPixel(v, imageA.getPixel(v));
+            const uint32_t* rowsA[3] = { a.getRow(std::max(y-1, 0)), a.getRow(y), a.getRow(std::min(y+1, height-1)) };
+            const uint32_t* rowsB[3] = { b.getRow(std::max(y-1, 0)), b.getRow(y), b.getRow(std::min(y+1, height-1)) };
+            compareRow(rowsA, rowsB, width, &row[0]);
+            storeRow(result, 0, y, &row[0], width);
         }
+    });
+    return result;
+}
+
+pp::SwapScores pp::swapScores(cinder::Surface& imageA, cinder::Surface& imageB, cinder::Surface& errorA, cinder::Surface& secondWeight)
+{
+    int width = std::min(imageA.getWidth(), imageB.getWidth());
+    int height = std::min(imageA.getHeight(), imageB.getHeight());
+
+    PixelBuffer a(imageA, 0);
+    PixelBuffer b(imageB, 0);
+    PixelBuffer weight(secondWeight, 0);
+    PixelBuffer compared(errorA, 0);
+    // squared errors with a clamped border column on either side
+    std::vector<int> errors((width + 2) * height);
+    for (int y = 0; y < height; y++)
+    {
+        int* line = &errors[y * (width + 2)];
+        errorRow(compared.getRow(y), width, line + 1);
+        line[0] = line[1];
+        line[width + 1] = line[width];
+    }
 
+    SwapScores result;
+    result.width = width;
+    result.height = height;
+    result.scores.resize(width * height);
+    result.imageA.resize(width * height);
+    result.imageB.resize(width * height);
+    for (int y = 0; y < height; y++)
+    {
+        const int* errorRows[3] = { &errors[std::max(y-1, 0) * (width + 2)] + 1,
+                                    &errors[y * (width + 2)] + 1,
+                                    &errors[std::min(y+1, height-1) * (width + 2)] + 1 };
+        scoreRow(errorRows, weight.getRow(y), width, &result.scores[y * width]);
+        std::copy(a.getRow(y), a.getRow(y) + width, &result.imageA[y * width]);
+        std::copy(b.getRow(y), b.getRow(y) + width, &result.imageB[y * width]);
+    }
     return result;
 }
 
+Surface pp::choose(cinder::Surface& imageA, cinder::Surface& imageB, cinder::Surface& errorA, cinder::Surface& secondWeight, float threshold)
+{
+    return choose(swapScores(imageA, imageB, errorA, secondWeight), threshold);
+}
+
+Surface pp::choose(const SwapScores& scores, float threshold)
+{
+    int width = scores.width;
+    Surface result(width, scores.height, false);
+    std::vector<uint32_t> row(width);
+    for (int y = 0; y < scores.height; y++)
+    {
+        int offset = y * width;
+        selectRow(&scores.imageA[offset], &scores.imageB[offset], &scores.scores[offset], width, threshold, &row[0]);
+        storeRow(result, 0, y, &row[0], width);
+    }
+    return result;
+}
+
+std::vector<int> pp::swapHistogram(const SwapScores& scores, int bins)
+{
+    //  a score swaps at every threshold below score / (3*127*127); count each at the last
+    //  bin it swaps at, then sum from the top
+    std::vector<int> counts(bins + 1, 0);
+    for (size_t i = 0; i < scores.scores.size(); i++)
+    {
+        float score = scores.scores[i];
+        if (score <= 0)
+            continue;
+        int last = (int)std::ceil(score * bins / (3*127*127)) - 1;
+        counts[std::min(last, bins)]++;
+    }
+    for (int i = bins - 1; i >= 0; i--)
+        counts[i] += counts[i + 1];
+    return counts;
+}
+
 /*
 if(swap)
 {
@@ -2,17 +2,48 @@
 
 #include "cinder/Cinder.h"
 #include "cinder/Surface.h"
-#include <list>
+#include <vector>
 
 namespace pp
 {
     const float EPSILON = 0.01f;
 
-    typedef std::list<cinder::Color8u> Palette;
+    typedef std::vector<cinder::Color8u> Palette;
 
 
     void genDest(cinder::Surface& source, int scaleFactor, cinder::Surface& result);
+    // Every distinct color of source in column-major order of first appearance; frequencies
+    // receives the number of pixels of each color.
     void getColors(cinder::Surface& source, Palette& result);
+    void getColors(cinder::Surface& source, Palette& result, std::vector<int>& frequencies);
     cinder::Surface compare(cinder::Surface& imageA, cinder::Surface& imageB);
     cinder::Surface choose(cinder::Surface& imageA, cinder::Surface& imageB, cinder::Surface& errorA, cinder::Surface& secondWeight, float threshold);
+
+    // choose() up to the threshold: both candidates as packed pixels and per pixel the score
+    // sqrt(errA) * alternative, -infinity where errA is not a local maximum. A pixel takes
+    // imageB when its score is above threshold * 3*127*127.
+    struct SwapScores
+    {
+        SwapScores() : width(0), height(0) {}
+        int width;
+        int height;
+        std::vector<float> scores;
+        std::vector<uint32_t> imageA;
+        std::vector<uint32_t> imageB;
+    };
+    SwapScores swapScores(cinder::Surface& imageA, cinder::Surface& imageB, cinder::Surface& errorA, cinder::Surface& secondWeight);
+    // the same as choose() with the images scores was built from, in a single select per pixel
+    cinder::Surface choose(const SwapScores& scores, float threshold);
+    // bins + 1 counts, the number of pixels swapped at threshold i / bins
+    std::vector<int> swapHistogram(const SwapScores& scores, int bins);
+
+    // Row kernels behind compare() and choose() on packed pixels. rows/errorRows hold the line
+    // above, the line itself and the line below, each readable one pixel left and right of 0..width-1.
+    // chooseRow() is scoreRow() followed by selectRow().
+    void compareRow(const uint32_t* const* rowsA, const uint32_t* const* rowsB, int width, uint32_t* out);
+    void errorRow(const uint32_t* compareRow, int width, int* out);
+    void chooseRow(const uint32_t* imageA, const uint32_t* imageB, const int* const* errorRows, const uint32_t* secondWeight,
+                   int width, float threshold, uint32_t* out);
+    void scoreRow(const int* const* errorRows, const uint32_t* secondWeight, int width, float* out);
+    void selectRow(const uint32_t* imageA, const uint32_t* imageB, const float* scores, int width, float threshold, uint32_t* out);
 }  // namespace pp
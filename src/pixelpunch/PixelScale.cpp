@@ -1,6 +1,7 @@
 #include "PixelPunch.h"
 #include "Kernel.h"
 #include "PixelScale.h"
+#include <algorithm>
 #include <cassert>
 
 using namespace cinder;
@@ -33,14 +34,70 @@ void _repeat(Surface& source, Surface& dest, int scaleFactor)
     }
 }
 
+//  Runs of source pixels whose 3x3 neighbourhood is a single color (rgb, as the kernels read
+//  them). The 3x3 rules all keep such a pixel as it is, so its scaled block is that color.
+//  Follows the kernels through the source a pixel or a run at a time; runs are looked for
+//  from the start of each block on.
+class _FlatRuns
+{
+ public:
+    explicit _FlatRuns(const PixelBuffer& pixels) : mBlocks(pixels, 0x00FFFFFF), mWidth(pixels.getWidth()), mX(0), mY(0) {}
+
+    //  flat pixels from the current one on in the row, all of color; 0 if there are none
+    int next(uint32_t& color) const
+    {
+        const int size = UniformBlocks::BLOCK_SIZE;
+        int run = 0;
+        if (mX % size != 0)
+            return 0;
+        while (mX + run < mWidth)
+        {
+            int end = std::min(mX + run + size, mWidth);
+            uint32_t c;
+            if (!mBlocks.isUniform(mX + run - 1, mY - 1, end, mY + 1, c) || (run > 0 && c != color))
+                break;
+            color = c;
+            run = end - mX;
+        }
+        return run;
+    }
+
+    void advance(int count)
+    {
+        mX += count;
+        if (mX >= mWidth)
+        {
+            mX = 0;
+            mY++;
+        }
+    }
+
+ private:
+    UniformBlocks mBlocks;
+    int mWidth;
+    int mX;
+    int mY;
+};
+
 void _scale2x(Surface& source, Surface& dest)
 {
     Kernel kSrc(source, 3, 3, 1, 1);
     Kernel kDst(dest, 2, 2);
+    _FlatRuns flat(kSrc.getBuffer());
     uint32_t** src = kSrc.pixels;
     uint32_t** dst = kDst.pixels;
-    do
+    bool more = true;
+    while (more)
     {
+        uint32_t color;
+        int run = flat.next(color);
+        flat.advance(std::max(run, 1));
+        if (run > 0)
+        {
+            kSrc.step(run, 1);
+            more = kDst.fill(color, run, 2);
+            continue;
+        }
         /*
         A B C
         D E F -> E0 E1 -> 00 10
@@ -58,18 +115,29 @@ void _scale2x(Surface& source, Surface& dest)
         dst[1][0] = prereq && (src[1][0] == src[2][1]) ? src[2][1] : src[1][1];
         dst[0][1] = prereq && (src[0][1] == src[1][2]) ? src[0][1] : src[1][1];
         dst[1][1] = prereq && (src[1][2] == src[2][1]) ? src[2][1] : src[1][1];
+        more = kDst.write(2);
     }
-    while (kDst.write(2));
 }
 
 void _scale3x(Surface& source, Surface& dest)
 {
     Kernel kSrc(source, 3, 3, 1, 1);
     Kernel kDst(dest, 3, 3, 0, 0);
+    _FlatRuns flat(kSrc.getBuffer());
     uint32_t** src = kSrc.pixels;
     uint32_t** dst = kDst.pixels;
-    do
+    bool more = true;
+    while (more)
     {
+        uint32_t color;
+        int run = flat.next(color);
+        flat.advance(std::max(run, 1));
+        if (run > 0)
+        {
+            kSrc.step(run, 1);
+            more = kDst.fill(color, run, 3);
+            continue;
+        }
     /*
         A B C    E0 E1 E2     00 10 20
         D E F -> E3 E4 E5 ->  01 11 21
@@ -110,18 +178,29 @@ void _scale3x(Surface& source, Surface& dest)
         dst[0][2] = prereq && D_is_H                                        ? src[0][1] : src[1][1];
         dst[1][2] = prereq && ((D_is_H && E_not_I) || (H_is_F && E_not_G))  ? src[1][2] : src[1][1];
         dst[2][2] = prereq && H_is_F                                        ? src[2][1] : src[1][1];
+        more = kDst.write(3);
     }
-    while (kDst.write(3));
 }
 
 void _eagle2x(Surface& source, Surface& dest)
 {
     Kernel kSrc(source, 3, 3, 1, 1);
     Kernel kDst(dest, 2, 2);
+    _FlatRuns flat(kSrc.getBuffer());
     uint32_t** src = kSrc.pixels;
     uint32_t** dst = kDst.pixels;
-    do
+    bool more = true;
+    while (more)
     {
+        uint32_t color;
+        int run = flat.next(color);
+        flat.advance(std::max(run, 1));
+        if (run > 0)
+        {
+            kSrc.step(run, 1);
+            more = kDst.fill(color, run, 2);
+            continue;
+        }
         /*
         first:        |Then 
         . . . --\ CC  |00 10 20     S T U  --\ 1 2
@@ -137,8 +216,8 @@ void _eagle2x(Surface& source, Surface& dest)
         dst[1][0] = (src[1][0] == src[2][0] && src[2][1] == src[2][0]) ? src[2][0] : src[1][1];
         dst[0][1] = (src[0][1] == src[0][2] && src[1][2] == src[0][2]) ? src[0][2] : src[1][1];
         dst[1][1] = (src[2][1] == src[2][2] && src[1][2] == src[2][2]) ? src[2][2] : src[1][1];
+        more = kDst.write(2);
     }
-    while (kDst.write(2));
 }
 
 
@@ -354,3 +433,47 @@ Surface pp::scale(Surface& source, ScaleMethod method)
     }
     return result;
 }
+
+int pp::scaleFactor(ScaleMethod method)
+{
+    switch (method)
+    {
+    case SM_SCALE2x:
+    case SM_EAGLE2x:
+    case SM_SCALE2x_HQ:
+        return 2;
+    case SM_SCALE3x:
+    case SM_SCALE3x_HQ:
+        return 3;
+    case SM_SCALE4x:
+    case SM_SCALE4x_HQ:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+bool pp::isLocalScale(ScaleMethod method)
+{
+    return method == SM_NONE || method == SM_SCALE2x || method == SM_SCALE3x || method == SM_SCALE4x || method == SM_EAGLE2x;
+}
+
+Surface pp::scaleRegion(Surface& source, ScaleMethod method, const Area& region)
+{
+    //  the source pixels behind the region and the neighbours the 3x3 kernels look at, two
+    //  of them as SM_SCALE4x looks twice; only edges of the source itself are clamped then
+    const int margin = 2;
+    int factor = scaleFactor(method);
+    Area part = source.getBounds();
+    if (isLocalScale(method))
+        part = Area(std::max(0, region.x1 / factor - margin),
+                    std::max(0, region.y1 / factor - margin),
+                    std::min(source.getWidth(), (region.x2 + factor - 1) / factor + margin),
+                    std::min(source.getHeight(), (region.y2 + factor - 1) / factor + margin));
+
+    Surface cropped = source.clone(part);
+    Surface scaled = scale(cropped, method);
+    int x = region.x1 - part.x1 * factor;
+    int y = region.y1 - part.y1 * factor;
+    return scaled.clone(Area(x, y, x + region.getWidth(), y + region.getHeight()));
+}
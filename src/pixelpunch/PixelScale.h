@@ -21,4 +21,11 @@ namespace pp
     typedef enum ScaleMethod ScaleMethod;
 
     cinder::Surface scale(cinder::Surface& source, ScaleMethod method);
+
+    int scaleFactor(ScaleMethod method);
+    // true if every scaled pixel only depends on the source pixels next to the one it comes
+    // from; the HQ methods clean up in place, so a pixel can depend on any other
+    bool isLocalScale(ScaleMethod method);
+    // region of scale(source, method), for local methods from the part of source it comes from
+    cinder::Surface scaleRegion(cinder::Surface& source, ScaleMethod method, const cinder::Area& region);
 }  // namespace pp
@@ -0,0 +1,51 @@
+#pragma once
+
+// Instruction set detection for the vectorized inner loops. Every SIMD path has a
+// scalar fallback so the code builds on any target. SSE2 is part of the x86-64
+// baseline and is used whenever the compiler targets it; the AVX2 paths are built
+// into every x86 binary with PP_TARGET_AVX2 and only taken when pp::hasAvx2() says
+// the CPU and OS support them, so no project needs -mavx2 (/arch:AVX2).
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define PP_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define PP_SSE2 1
+#endif
+
+#if defined(PP_AVX2)
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        //  MSVC accepts AVX2 intrinsics without /arch:AVX2
+        #define PP_TARGET_AVX2
+    #else
+        #define PP_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+
+namespace pp
+{
+    //  true when the CPU has AVX2 and the OS saves the YMM registers, call it once
+    //  and keep the result, cpuid is slow
+    inline bool hasAvx2()
+    {
+    #if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const int osxsave = 1 << 27, avx = 1 << 28;
+        if ((info[2] & (osxsave | avx)) != (osxsave | avx) || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    #else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    #endif
+    }
+}
+#elif defined(PP_SSE2)
+    #include <emmintrin.h>
+#endif
@@ -1,8 +1,17 @@
 #include "PixelPunch.h"
 #include "PixelTransform.h"
 #include "Kernel.h"
+#include "PixelSimd.h"
+#include "PixelParallel.h"
 #include "cinder/Matrix.h"
+#include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <cstdlib>
+#include <vector>
 
 using namespace cinder;
 using namespace pp;
@@ -37,6 +46,26 @@ TransformMapping::TransformMapping(const Rectf& rect)
     localQuad[3] = bounds.getLowerLeft() - topLeft;
 }
 
+std::vector<TransformMapping> pp::rotationMappings(const Rectf& targetRect, const std::vector<float>& angles)
+{
+    std::vector<TransformMapping> mappings;
+    vec2 center = targetRect.getCenter();
+    vec2 corners[4] = { targetRect.getUpperLeft(), targetRect.getUpperRight(), targetRect.getLowerRight(), targetRect.getLowerLeft() };
+    for (size_t i = 0; i < angles.size(); i++)
+    {
+        float c = cos(angles[i]);
+        float s = sin(angles[i]);
+        vec2 quad[4];
+        for (int k = 0; k < 4; k++)
+        {
+            vec2 d = corners[k] - center;
+            quad[k] = center + vec2(c * d.x - s * d.y, s * d.x + c * d.y);
+        }
+        mappings.push_back(TransformMapping(quad));
+    }
+    return mappings;
+}
+
 mat3 _mapUnitSquareToQuad(ci::vec2* quad)
 {
     mat3 result;
@@ -87,126 +116,2125 @@ mat3 _mapUnitSquareToQuad(ci::vec2* quad)
     return result;
 }
 
+const uint32_t BLANK_PIXEL = 0;
+
 template<class Sampler>
-void _drawProjective(Sampler& sampler, TransformMapping& srcMapping, Surface& dest, TransformMapping& destMapping)
+void _sampleRow(Sampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
 {
-    //  calculate matrix mapping each pixel in target to a coordinate in source
-    mat3 uvToTarget = _mapUnitSquareToQuad(destMapping.localQuad);
-    mat3 targetToUV = inverse(uvToTarget);
-    mat3 uvToSource = _mapUnitSquareToQuad(srcMapping.localQuad);
-    mat3 targetToSource = uvToSource * targetToUV;
-
-    //  for each target pixel find one in source!
     float srcWidth = sampler.source.getWidth();
     float srcHeight = sampler.source.getHeight();
-    Color8u blank = Color8u();
-    for (int x = 0; x < dest.getWidth(); x++)
-        for (int y = 0; y < dest.getHeight(); y++)
+    for (int i = 0; i < count; i++)
+    {
+        if (xs[i] >= 0 && ys[i] >= 0 && xs[i] < srcWidth && ys[i] < srcHeight)
+            out[i] = packPixel(sampler(xs[i], ys[i]));
+        else
+            out[i] = BLANK_PIXEL;
+    }
+}
+
+void _sampleRow(NearestNeighbourSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    sampler.sampleRow(xs, ys, count, out);
+}
+
+void _sampleRow(BilinearSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    sampler.sampleRow(xs, ys, count, out);
+}
+
+void _sampleRow(BicubicSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    sampler.sampleRow(xs, ys, count, out);
+}
+
+void _sampleRow(BicubicBestFitSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    sampler.sampleRow(xs, ys, count, out);
+}
+
+void _sampleRow(AreaSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    sampler.sampleRow(xs, ys, count, out);
+}
+
+void _sampleRow(BilinearDominanceSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    sampler.sampleRow(xs, ys, count, out);
+}
+
+void _sampleRow(WeightSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    sampler.sampleRow(xs, ys, count, out);
+}
+
+//  samplers that filter over a footprint also get the coordinates of the next row
+template<class Sampler>
+void _sampleRow(Sampler& sampler, const float* xs, const float* ys, const float*, const float*, int count, uint32_t* out)
+{
+    _sampleRow(sampler, xs, ys, count, out);
+}
+
+void _sampleRow(AreaSampler& sampler, const float* xs, const float* ys, const float* nextXs, const float* nextYs, int count, uint32_t* out)
+{
+    sampler.sampleRow(xs, ys, nextXs, nextYs, count, out);
+}
+
+//  _sampleRow for TransformOptions::fixedPoint, integer weights where the sampler has float ones
+template<class Sampler>
+void _sampleRowFixed(Sampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    _sampleRow(sampler, xs, ys, count, out);
+}
+
+template<class Sampler>
+void _sampleRowFixed(Sampler& sampler, const float* xs, const float* ys, const float* nextXs, const float* nextYs, int count, uint32_t* out)
+{
+    _sampleRow(sampler, xs, ys, nextXs, nextYs, count, out);
+}
+
+void _sampleRowFixed(BicubicSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out);
+
+void _sampleRowFixed(BicubicSampler& sampler, const float* xs, const float* ys, const float*, const float*, int count, uint32_t* out)
+{
+    _sampleRowFixed(sampler, xs, ys, count, out);
+}
+
+//  samplers whose sample at a pixel's own coordinate is that pixel, so that mappings onto
+//  whole pixels can be copied instead of sampled
+template<class Sampler>
+bool _exactOnPixels(const Sampler&)
+{
+    return false;
+}
+
+bool _exactOnPixels(const NearestNeighbourSampler&)
+{
+    return true;
+}
+
+bool _exactOnPixels(const BilinearSampler&)
+{
+    return true;
+}
+
+bool _exactOnPixels(const BicubicSampler&)
+{
+    return true;
+}
+
+vec2 _transformInvBilinear(vec2 p, vec2* q)
+{
+    //  non-inverse is easy:
+    //  p = (1-u)*(1-v)*q[0] + (1-u)*v*q[3] + u*(1-v)*q[1] + u*v*q[2]
+    //  solve p.x and p.y to v and get
+    //  v = ( (1-u)*(x0-x) + u*(x1-x) ) / ( (1-u)*(x0-x3) + u*(x1-x2) )
+    //  v = ( (1-u)*(y0-y) + u*(y1-y) ) / ( (1-u)*(y0-y3) + u*(y1-y2) )
+
+    //  A*(1-u)^2 + B*2u(1-u) + C*u^2 = 0
+
+    double A = cross(vec3(q[0]-p, 0), vec3(q[0]-q[3], 0)).z;
+    double B = (cross(vec3(q[0]-p, 0), vec3(q[1]-q[2], 0)).z + cross(vec3(q[1]-p, 0), vec3(q[0]-q[3], 0)).z) / 2;
+    double C = cross(vec3(q[1]-p, 0), vec3(q[1]-q[2], 0)).z;
+
+    //  FIND U
+    double u = 0;
+    double div = (A - 2*B + C);
+    if (std::abs(div) < ci::EPSILON_VALUE)
+        u = ((A-C) != 0) ? A / (A-C) : 0;  //  U
+    else
+    {
+        u = ((A-B) + sqrt(B*B - A*C)) / div;
+        if (u < 0 || u > 1)
+            u = ((A-B) - sqrt(B*B - A*C)) / div;
+    }
+
+    //  FIND V
+    double v = 0;
+    vec2 vDiv = (float)(1-u) * (vec2(q[0]-q[3])) + (float)u*(vec2(q[1]-q[2]));
+    if (fabs(vDiv.x) > fabs(vDiv.y))
+        v = ( (1-u)*(q[0].x-p.x) + u*(q[1].x-p.x) ) / vDiv.x;
+    else if (vDiv.y != 0)
+        v = ( (1-u)*(q[0].y-p.y) + u*(q[1].y-p.y) ) / vDiv.y;
+
+    return vec2(u, v);
+}
+
+//  maps target pixel coordinates to coordinates in source
+class _TargetToSource
+{
+ public:
+    _TargetToSource(TransformMethod method, TransformMapping& srcMapping, TransformMapping& destMapping)
+    :   mMethod(method == TM_ROTATE_SHEAR ? TM_PROJECTIVE : method),
+        mDestQuad(destMapping.localQuad)
+    {
+        mat3 uvToSource = _mapUnitSquareToQuad(srcMapping.localQuad);
+        if (mMethod == TM_PROJECTIVE)
+        {
+            mat3 uvToTarget = _mapUnitSquareToQuad(destMapping.localQuad);
+            mat3 targetToUV = inverse(uvToTarget);
+            mMatrix = uvToSource * targetToUV;
+        }
+        else
+            mMatrix = uvToSource;
+    }
+
+    vec2 operator()(float x, float y) const
+    {
+        vec3 vSrc;
+        if (mMethod == TM_PROJECTIVE)
+            vSrc = mMatrix * vec3(x, y, 1);
+        else
+        {
+            vec2 uv = _transformInvBilinear(vec2(x, y), mDestQuad);
+            vSrc = mMatrix * vec3(uv.x, uv.y, 1);
+        }
+        vSrc /= vSrc.z;
+        return vec2(vSrc.x, vSrc.y);
+    }
+
+    //  TM_PROJECTIVE only: the source x where target column x crosses source row v
+    float crossRow(float x, float v) const
+    {
+        const mat3& m = mMatrix;
+        float y = (m[0][1] * x + m[2][1] - v * (m[0][2] * x + m[2][2])) / (v * m[1][2] - m[1][1]);
+        vec3 vSrc = m * vec3(x, y, 1);
+        return vSrc.x / vSrc.z;
+    }
+
+    //  crossRow for 'count' columns starting at x
+    void crossRow(int v, int x, int count, float* xs) const
+    {
+        const mat3& m = mMatrix;
+        float d = v * m[1][2] - m[1][1];
+        for (int i = 0; i < count; i++)
+        {
+            float cx = x + i;
+            float y = (m[0][1] * cx + m[2][1] - v * (m[0][2] * cx + m[2][2])) / d;
+            xs[i] = (m[0][0] * cx + m[1][0] * y + m[2][0]) / (m[0][2] * cx + m[1][2] * y + m[2][2]);
+        }
+    }
+
+    //  maps 'count' pixels of row y starting at column x
+    void mapRow(int y, int x, int count, float* xs, float* ys) const
+    {
+        for (int i = 0; i < count; i++)
+        {
+            vec2 p = (*this)(x + i, y);
+            xs[i] = p.x;
+            ys[i] = p.y;
+        }
+    }
+
+ private:
+    TransformMethod mMethod;
+    vec2* mDestQuad;
+    mat3 mMatrix;   // target to source for TM_PROJECTIVE, uv to source for TM_BILINEAR
+};
+
+//  _mapUnitSquareToQuad in double and row-major, a[row][column]
+void _mapUnitSquareToQuad(const vec2* quad, double a[3][3])
+{
+    double px = (double)quad[0].x - quad[1].x + quad[2].x - quad[3].x;
+    double py = (double)quad[0].y - quad[1].y + quad[2].y - quad[3].y;
+    a[0][2] = quad[0].x;
+    a[1][2] = quad[0].y;
+    a[2][2] = 1;
+    if (px == 0 && py == 0)
+    {
+        a[0][0] = (double)quad[1].x - quad[0].x;
+        a[0][1] = (double)quad[2].x - quad[1].x;
+        a[1][0] = (double)quad[1].y - quad[0].y;
+        a[1][1] = (double)quad[2].y - quad[1].y;
+        a[2][0] = 0;
+        a[2][1] = 0;
+    }
+    else
+    {
+        double d1x = (double)quad[1].x - quad[2].x;
+        double d1y = (double)quad[1].y - quad[2].y;
+        double d2x = (double)quad[3].x - quad[2].x;
+        double d2y = (double)quad[3].y - quad[2].y;
+        double del = d1x * d2y - d1y * d2x;
+        assert(del != 0);
+        a[2][0] = (px * d2y - py * d2x) / del;
+        a[2][1] = (d1x * py - d1y * px) / del;
+        a[0][0] = (double)quad[1].x - quad[0].x + a[2][0] * quad[1].x;
+        a[0][1] = (double)quad[3].x - quad[0].x + a[2][1] * quad[3].x;
+        a[1][0] = (double)quad[1].y - quad[0].y + a[2][0] * quad[1].y;
+        a[1][1] = (double)quad[3].y - quad[0].y + a[2][1] * quad[3].y;
+    }
+}
+
+//  Maps target pixels onto the 1/512 grid of the samplers with integers only. The
+//  projective matrix is set up once in double and rounded to 64 bit coefficients; from
+//  there numerators and denominator are exact and every coordinate is rounded down, with
+//  a shift if the mapping is affine and a division if not. TM_BILINEAR keeps the float
+//  inverse of _TargetToSource and is only rounded down onto the grid.
+class _FixedTargetToSource
+{
+ public:
+    _FixedTargetToSource(TransformMethod method, TransformMapping& srcMapping, TransformMapping& destMapping)
+    :   mBilinear(method == TM_BILINEAR),
+        mAffine(false),
+        mFloat(method, srcMapping, destMapping),
+        mBits(0)
+    {
+        if (mBilinear)
+            return;
+
+        //  target to source is uv to source times the inverse of uv to target, which up to a
+        //  factor is its adjugate; the factor cancels out in the division by w
+        double s[3][3], t[3][3], adj[3][3], m[3][3];
+        _mapUnitSquareToQuad(srcMapping.localQuad, s);
+        _mapUnitSquareToQuad(destMapping.localQuad, t);
+        adj[0][0] = t[1][1] * t[2][2] - t[1][2] * t[2][1];
+        adj[0][1] = t[0][2] * t[2][1] - t[0][1] * t[2][2];
+        adj[0][2] = t[0][1] * t[1][2] - t[0][2] * t[1][1];
+        adj[1][0] = t[1][2] * t[2][0] - t[1][0] * t[2][2];
+        adj[1][1] = t[0][0] * t[2][2] - t[0][2] * t[2][0];
+        adj[1][2] = t[0][2] * t[1][0] - t[0][0] * t[1][2];
+        adj[2][0] = t[1][0] * t[2][1] - t[1][1] * t[2][0];
+        adj[2][1] = t[0][1] * t[2][0] - t[0][0] * t[2][1];
+        adj[2][2] = t[0][0] * t[1][1] - t[0][1] * t[1][0];
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+                m[r][c] = s[r][0] * adj[0][c] + s[r][1] * adj[1][c] + s[r][2] * adj[2][c];
+
+        //  w is 1 everywhere for affine mappings, else positive inside the quad and at most 1
+        //  at the corners of the target
+        mAffine = (m[2][0] == 0 && m[2][1] == 0);
+        double scale = 1 / m[2][2];
+        if (!mAffine)
+        {
+            double width = destMapping.bounds.getWidth();
+            double height = destMapping.bounds.getHeight();
+            double largest = 0;
+            for (int corner = 0; corner < 4; corner++)
+            {
+                double x = (corner & 1) ? width : 0;
+                double y = (corner & 2) ? height : 0;
+                largest = std::max(largest, std::abs(m[2][0] * x + m[2][1] * y + m[2][2]));
+            }
+            double center = m[2][0] * width / 2 + m[2][1] * height / 2 + m[2][2];
+            scale = (center < 0 ? -1 : 1) / largest;
+        }
+
+        //  as many fraction bits as keep 512 * numerator within 62 bits at any position
+        //  operator() looks at, in 1/256 of a pixel
+        double reach = (std::max(destMapping.bounds.getWidth(), destMapping.bounds.getHeight()) + 2) * SUBPIXELS;
+        double bound = 1;
+        for (int r = 0; r < 3; r++)
+            bound = std::max(bound, (std::abs(m[r][0]) + std::abs(m[r][1])) * std::abs(scale) * reach + std::abs(m[r][2] * scale) * SUBPIXELS);
+        int exponent;
+        std::frexp(bound, &exponent);
+        mBits = std::max(9 + 1, 52 - exponent);
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+                mCoefficients[r][c] = std::llround(std::ldexp(m[r][c] * scale, mBits));
+    }
+
+    //  at a point between pixels, rounded to 1/256 of a pixel
+    vec2 operator()(float x, float y) const
+    {
+        if (mBilinear)
+            return _snap(mFloat(x, y));
+        int64_t tx = std::llround(x * (double)SUBPIXELS);
+        int64_t ty = std::llround(y * (double)SUBPIXELS);
+        const int64_t (*m)[3] = mCoefficients;
+        int64_t w = m[2][0] * tx + m[2][1] * ty + m[2][2] * SUBPIXELS;
+        return vec2(_toGrid(m[0][0] * tx + m[0][1] * ty + m[0][2] * SUBPIXELS, w, SUBPIXEL_BITS),
+                    _toGrid(m[1][0] * tx + m[1][1] * ty + m[1][2] * SUBPIXELS, w, SUBPIXEL_BITS));
+    }
+
+    //  maps 'count' pixels of row y starting at column x
+    void mapRow(int y, int x, int count, float* xs, float* ys) const
+    {
+        if (mBilinear)
+        {
+            mFloat.mapRow(y, x, count, xs, ys);
+            for (int i = 0; i < count; i++)
+            {
+                vec2 p = _snap(vec2(xs[i], ys[i]));
+                xs[i] = p.x;
+                ys[i] = p.y;
+            }
+            return;
+        }
+        const int64_t (*m)[3] = mCoefficients;
+        int64_t sx = m[0][0] * x + m[0][1] * y + m[0][2];
+        int64_t sy = m[1][0] * x + m[1][1] * y + m[1][2];
+        int64_t w = m[2][0] * x + m[2][1] * y + m[2][2];
+        for (int i = 0; i < count; i++, sx += m[0][0], sy += m[1][0], w += m[2][0])
+        {
+            xs[i] = _toGrid(sx, w, 0);
+            ys[i] = _toGrid(sy, w, 0);
+        }
+    }
+
+ private:
+    static const int SUBPIXEL_BITS = 8;
+    static const int SUBPIXELS = 1 << SUBPIXEL_BITS;
+
+    //  floor(512 * n / w) as a coordinate for positions in 1/2^subBits of a pixel; -1,
+    //  outside any source, where the mapping flips over behind the quad
+    float _toGrid(int64_t n, int64_t w, int subBits) const
+    {
+        int64_t grid;
+        if (mAffine)
+            grid = n >> (mBits + subBits - 9);
+        else
+        {
+            if (w <= 0)
+                return -1;
+            n *= 512;
+            grid = n / w;
+            if (n % w != 0 && n < 0)
+                grid--;
+        }
+        //  floats hold the grid exactly up to 2^24, far outside any source
+        return (float)std::max<int64_t>(-1, std::min<int64_t>(grid, (1 << 24) - 1)) / 512;
+    }
+
+    static vec2 _snap(vec2 p)
+    {
+        return vec2(std::floor(p.x * 512.0f) / 512, std::floor(p.y * 512.0f) / 512);
+    }
+
+    bool mBilinear;
+    bool mAffine;
+    _TargetToSource mFloat;
+    int64_t mCoefficients[3][3];   // x, y and w of the source, row-major, mBits fraction bits
+    int mBits;
+};
+
+//  true if any of the 8 neighbours of p differs from it by more than threshold in a channel
+inline bool _isEdge(const uint32_t* p, int stride, int threshold)
+{
+    const int offsets[8] = { -stride-1, -stride, -stride+1, -1, 1, stride-1, stride, stride+1 };
+    uint32_t c = p[0];
+    for (int i = 0; i < 8; i++)
+    {
+        uint32_t n = p[offsets[i]];
+        if (n == c)
+            continue;
+        for (int shift = 0; shift < 32; shift += 8)
+            if (std::abs((int)(0xFF & (c >> shift)) - (int)(0xFF & (n >> shift))) > threshold)
+                return true;
+    }
+    return false;
+}
+
+const int TILE_SIZE = 64;
+
+//  true if no pixel within one pixel of the tile [x0, x1) x [y0, y1) can fall inside the quad,
+//  i.e. the widened tile lies entirely outside one of its edges. Only convex quads are tested,
+//  anything else never counts as outside.
+bool _tileOutsideQuad(const vec2* quad, int x0, int y0, int x1, int y1)
+{
+    float turn[4];
+    for (int i = 0; i < 4; i++)
+    {
+        vec2 a = quad[(i+1) % 4] - quad[i];
+        vec2 b = quad[(i+2) % 4] - quad[(i+1) % 4];
+        turn[i] = a.x * b.y - a.y * b.x;
+    }
+    bool clockwise = turn[0] > 0 && turn[1] > 0 && turn[2] > 0 && turn[3] > 0;
+    bool counterClockwise = turn[0] < 0 && turn[1] < 0 && turn[2] < 0 && turn[3] < 0;
+    if (!clockwise && !counterClockwise)
+        return false;
+
+    vec2 corners[4] = { vec2(x0 - 1, y0 - 1), vec2(x1, y0 - 1), vec2(x1, y1), vec2(x0 - 1, y1) };
+    for (int i = 0; i < 4; i++)
+    {
+        vec2 edge = quad[(i+1) % 4] - quad[i];
+        int outside = 0;
+        for (int c = 0; c < 4; c++)
+        {
+            vec2 d = corners[c] - quad[i];
+            float side = edge.x * d.y - edge.y * d.x;
+            if (clockwise ? side < 0 : side > 0)
+                outside++;
+        }
+        if (outside == 4)
+            return true;
+    }
+    return false;
+}
+
+//  Maps the target in TILE_SIZE squares spread over all cores. Each row of a tile goes to
+//  drawRow(y, x, count, xs, ys, nextXs, nextYs) with count + 1 coordinates from column x on
+//  in the row and in the row below; rows of tiles the quad does not touch go to
+//  clearRow(y, x, count) instead. Both are called concurrently for different tiles.
+template<class DrawRow, class ClearRow>
+void _drawTiles(TransformMethod method, TransformMapping& srcMapping, TransformMapping& destMapping, int width, int height,
+                DrawRow drawRow, ClearRow clearRow)
+{
+    if (method != TM_PROJECTIVE && method != TM_ROTATE_SHEAR && method != TM_BILINEAR)
+        return;
+
+    _TargetToSource targetToSource(method, srcMapping, destMapping);
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    parallelFor(tilesX * tilesY, [&](int tile)
+    {
+        int x0 = (tile % tilesX) * TILE_SIZE;
+        int y0 = (tile / tilesX) * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, width);
+        int y1 = std::min(y0 + TILE_SIZE, height);
+        int count = x1 - x0;
+        if (_tileOutsideQuad(destMapping.localQuad, x0, y0, x1, y1))
+        {
+            for (int y = y0; y < y1; y++)
+                clearRow(y, x0, count);
+            return;
+        }
+
+        float coords[4 * (TILE_SIZE + 1)];
+        float* xs = coords;
+        float* ys = xs + TILE_SIZE + 1;
+        float* nextXs = ys + TILE_SIZE + 1;
+        float* nextYs = nextXs + TILE_SIZE + 1;
+        targetToSource.mapRow(y0, x0, count + 1, xs, ys);
+        for (int y = y0; y < y1; y++)
+        {
+            targetToSource.mapRow(y + 1, x0, count + 1, nextXs, nextYs);
+            drawRow(y, x0, count, xs, ys, nextXs, nextYs);
+            std::swap(xs, nextXs);
+            std::swap(ys, nextYs);
+        }
+    });
+}
+
+//  _drawTiles over coordinates mapped before
+template<class DrawRow, class ClearRow>
+void _drawTiles(const CoordinateMap& coordinates, DrawRow drawRow, ClearRow clearRow)
+{
+    const vec2* quad = coordinates.getTargetMapping().localQuad;
+    int width = coordinates.getWidth();
+    int height = coordinates.getHeight();
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    parallelFor(tilesX * tilesY, [&](int tile)
+    {
+        int x0 = (tile % tilesX) * TILE_SIZE;
+        int y0 = (tile / tilesX) * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, width);
+        int y1 = std::min(y0 + TILE_SIZE, height);
+        int count = x1 - x0;
+        bool outside = _tileOutsideQuad(quad, x0, y0, x1, y1);
+        for (int y = y0; y < y1; y++)
+        {
+            if (outside)
+                clearRow(y, x0, count);
+            else
+                drawRow(y, x0, count, coordinates.getXs(y) + x0, coordinates.getYs(y) + x0,
+                        coordinates.getXs(y + 1) + x0, coordinates.getYs(y + 1) + x0);
+        }
+    });
+}
+
+CoordinateMap::CoordinateMap()
+:   mTargetMapping(Rectf()),
+    mMethod(TM_IDENTITY),
+    mFixedPoint(false),
+    mWidth(0),
+    mHeight(0)
+{
+}
+
+CoordinateMap::CoordinateMap(const Area& sourceBounds, const TransformMapping& targetMapping, TransformMethod method, bool fixedPoint)
+:   mSourceBounds(sourceBounds),
+    mTargetMapping(targetMapping),
+    mMethod(method),
+    mFixedPoint(fixedPoint)
+{
+    TransformMapping srcMapping(sourceBounds);
+    //  without a transform every pixel maps onto itself
+    TransformMapping destMapping = (method == TM_IDENTITY) ? srcMapping : targetMapping;
+    if (method == TM_IDENTITY)
+        method = TM_PROJECTIVE;
+
+    mWidth = std::max(0, (int)destMapping.bounds.getWidth());
+    mHeight = std::max(0, (int)destMapping.bounds.getHeight());
+    int stride = mWidth + 1;
+    mXs = std::make_shared<std::vector<float> >(stride * (mHeight + 1));
+    mYs = std::make_shared<std::vector<float> >(stride * (mHeight + 1));
+    std::vector<float>& xs = *mXs;
+    std::vector<float>& ys = *mYs;
+    if (fixedPoint)
+    {
+        _FixedTargetToSource targetToSource(method, srcMapping, destMapping);
+        parallelFor(mHeight + 1, [&](int y)
+        {
+            targetToSource.mapRow(y, 0, stride, &xs[y * stride], &ys[y * stride]);
+        });
+        return;
+    }
+    _TargetToSource targetToSource(method, srcMapping, destMapping);
+    parallelFor(mHeight + 1, [&](int y)
+    {
+        targetToSource.mapRow(y, 0, stride, &xs[y * stride], &ys[y * stride]);
+    });
+}
+
+bool CoordinateMap::isFor(const Area& sourceBounds, const TransformMapping& targetMapping, TransformMethod method, bool fixedPoint) const
+{
+    if (!mXs || !(sourceBounds == mSourceBounds) || method != mMethod || fixedPoint != mFixedPoint)
+        return false;
+    if (method == TM_IDENTITY)
+        return true;
+    for (int i = 0; i < 4; i++)
+        if (targetMapping.localQuad[i] != mTargetMapping.localQuad[i])
+            return false;
+    const Rectf& a = targetMapping.bounds;
+    const Rectf& b = mTargetMapping.bounds;
+    return a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2;
+}
+
+//  target pixel (x, y) shows source pixel (ax * x + bx * y + cx, ay * x + by * y + cy)
+struct _PixelPermutation
+{
+    int ax, bx, cx;
+    int ay, by, cy;
+};
+
+//  a hundredth of a pixel anywhere in the target does not change which pixel is shown
+const float PERMUTATION_TOLERANCE = 0.01f;
+
+//  true if the mapping is a quarter turn, a flip, an integer offset or a combination of them.
+//  Checked at the corners and the center of the quad, which decide the mapping for both
+//  methods; the inverse bilinear mapping may also fold a mirrored quad, that fails here.
+bool _findPermutation(TransformMethod method, TransformMapping& srcMapping, TransformMapping& destMapping, _PixelPermutation& perm)
+{
+    if (method != TM_PROJECTIVE && method != TM_ROTATE_SHEAR && method != TM_BILINEAR)
+        return false;
+
+    _TargetToSource targetToSource(method, srcMapping, destMapping);
+    vec2 origin = targetToSource(0, 0);
+    vec2 stepX = targetToSource(1, 0) - origin;
+    vec2 stepY = targetToSource(0, 1) - origin;
+    perm.ax = (int)floor(stepX.x + 0.5f);
+    perm.ay = (int)floor(stepX.y + 0.5f);
+    perm.bx = (int)floor(stepY.x + 0.5f);
+    perm.by = (int)floor(stepY.y + 0.5f);
+    perm.cx = (int)floor(origin.x + 0.5f);
+    perm.cy = (int)floor(origin.y + 0.5f);
+
+    //  a single unit step per axis, in different directions
+    if (abs(perm.ax) + abs(perm.bx) != 1 || abs(perm.ay) + abs(perm.by) != 1 || abs(perm.ax) == abs(perm.ay))
+        return false;
+
+    const vec2* quad = destMapping.localQuad;
+    vec2 points[5] = { quad[0], quad[1], quad[2], quad[3], (quad[0] + quad[1] + quad[2] + quad[3]) * 0.25f };
+    for (int i = 0; i < 5; i++)
+    {
+        vec2 q = points[i];
+        vec2 s = targetToSource(q.x, q.y);
+        if (fabs(perm.ax * q.x + perm.bx * q.y + perm.cx - s.x) > PERMUTATION_TOLERANCE ||
+            fabs(perm.ay * q.x + perm.by * q.y + perm.cy - s.y) > PERMUTATION_TOLERANCE)
+            return false;
+    }
+    return true;
+}
+
+//  narrows the columns [begin, end) to those where s + step * (x - x0) lies in [0, size)
+void _clipSpan(int s, int step, int size, int x0, int& begin, int& end)
+{
+    int lo = begin;
+    int hi = end;
+    if (step == 0 && (s < 0 || s >= size))
+        hi = lo;
+    else if (step > 0)
+    {
+        lo = x0 - s;
+        hi = x0 + size - s;
+    }
+    else if (step < 0)
+    {
+        lo = x0 + s - size + 1;
+        hi = x0 + s + 1;
+    }
+    begin = std::max(begin, lo);
+    end = std::max(begin, std::min(end, hi));
+}
+
+//  copies the source pixels a permutation picks, blank where it points outside the source.
+//  The target goes in TILE_SIZE squares, so turned copies read the source a block at a time;
+//  rows that run along source rows are stored straight from the source.
+void _drawPermutation(const PixelBuffer& pixels, const _PixelPermutation& perm, Surface& result)
+{
+    int width = result.getWidth();
+    int height = result.getHeight();
+    const PixelAddressing& addressing = pixels.getAddressing();
+    bool rowCopy = perm.ax == 1 && perm.ay == 0 && pixels.getLayout() == PixelBuffer::ROW_MAJOR;
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    parallelFor(tilesX * tilesY, [&](int tile)
+    {
+        int x0 = (tile % tilesX) * TILE_SIZE;
+        int y0 = (tile / tilesX) * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, width);
+        int y1 = std::min(y0 + TILE_SIZE, height);
+        uint32_t row[TILE_SIZE] = { BLANK_PIXEL };
+        for (int y = y0; y < y1; y++)
         {
-            vec3 vSrc = targetToSource* vec3(x, y, 1);
+            //  source pixel of column x0
+            int sx = perm.ax * x0 + perm.bx * y + perm.cx;
+            int sy = perm.ay * x0 + perm.by * y + perm.cy;
+            int begin = x0;
+            int end = x1;
+            _clipSpan(sx, perm.ax, pixels.getWidth(), x0, begin, end);
+            _clipSpan(sy, perm.ay, pixels.getHeight(), x0, begin, end);
+            if (rowCopy)
+            {
+                std::fill(row, row + TILE_SIZE, BLANK_PIXEL);
+                storeRow(result, x0, y, row, begin - x0);
+                if (begin < end)
+                    storeRow(result, begin, y, pixels.getRow(sy) + sx + (begin - x0), end - begin);
+                storeRow(result, end, y, row, x1 - end);
+                continue;
+            }
+            for (int x = x0; x < x1; x++)
+            {
+                int i = x - x0;
+                row[i] = (x >= begin && x < end) ? *addressing(sx + perm.ax * i, sy + perm.ay * i) : BLANK_PIXEL;
+            }
+            storeRow(result, x0, y, row, x1 - x0);
+        }
+    });
+}
+
+//  target pixel (x, y) shows source point origin + x * stepX + y * stepY, where stepY is
+//  stepX turned a quarter clockwise on screen: a rotation, possibly scaled and moved
+struct _Rotation
+{
+    vec2 origin;
+    vec2 stepX;
+    vec2 stepY;
+};
+
+//  true if the mapping is a rotation, uniform scale and offset of the source. Checked like
+//  _findPermutation; the steps may not bend by more than the tolerance across the target.
+bool _findRotation(TransformMethod method, TransformMapping& srcMapping, TransformMapping& destMapping, _Rotation& rotation)
+{
+    if (method != TM_PROJECTIVE && method != TM_ROTATE_SHEAR && method != TM_BILINEAR)
+        return false;
+
+    //  steps measured across the whole target, a single pixel apart they would be too coarse
+    _TargetToSource targetToSource(method, srcMapping, destMapping);
+    float extent = std::max(1.0f, std::max(destMapping.bounds.getWidth(), destMapping.bounds.getHeight()));
+    rotation.origin = targetToSource(0, 0);
+    rotation.stepX = (targetToSource(extent, 0) - rotation.origin) / extent;
+    rotation.stepY = (targetToSource(0, extent) - rotation.origin) / extent;
+    vec2 turned(-rotation.stepX.y, rotation.stepX.x);
+    if (length(rotation.stepY - turned) * extent > PERMUTATION_TOLERANCE || length(rotation.stepX) == 0)
+        return false;
+
+    const vec2* quad = destMapping.localQuad;
+    vec2 points[5] = { quad[0], quad[1], quad[2], quad[3], (quad[0] + quad[1] + quad[2] + quad[3]) * 0.25f };
+    for (int i = 0; i < 5; i++)
+    {
+        vec2 q = points[i];
+        vec2 s = rotation.origin + q.x * rotation.stepX + q.y * rotation.stepY;
+        if (length(targetToSource(q.x, q.y) - s) > PERMUTATION_TOLERANCE)
+            return false;
+    }
+    return true;
+}
+
+//  how the shear passes resample a line, if the sampler has a 1D counterpart
+enum _ShearFilter
+{
+    SHEAR_NONE,
+    SHEAR_NEAREST,
+    SHEAR_LINEAR
+};
+
+template<class Sampler>
+_ShearFilter _shearFilter(const Sampler&)
+{
+    return SHEAR_NONE;
+}
+
+_ShearFilter _shearFilter(const NearestNeighbourSampler& sampler)
+{
+    return (sampler.pixels.getBorder() == PixelBuffer::BORDER_CLAMP) ? SHEAR_NEAREST : SHEAR_NONE;
+}
+
+_ShearFilter _shearFilter(const BilinearSampler& sampler)
+{
+    return (sampler.pixels.getBorder() == PixelBuffer::BORDER_CLAMP) ? SHEAR_LINEAR : SHEAR_NONE;
+}
+
+//  the dominant one of two neighbours on a line is the nearer one
+_ShearFilter _shearFilter(const BilinearDominanceSampler& sampler)
+{
+    return (sampler.order == 0) ? SHEAR_NEAREST : SHEAR_NONE;
+}
+
+PixelBuffer::Layout _sourceLayout(const Surface& source);
+
+//  the pixels of a sampler as PixelBuffer, indexed samplers only keep the indices
+template<class Sampler>
+const PixelBuffer& _packedPixels(const Sampler& sampler)
+{
+    return sampler.pixels;
+}
+
+PixelBuffer _packedPixels(const BilinearDominanceSampler& sampler)
+{
+    return sampler.indexed.empty() ? sampler.pixels : PixelBuffer(sampler.source, 1, _sourceLayout(sampler.source));
+}
+
+PixelBuffer _packedPixels(const WeightSampler& sampler)
+{
+    return sampler.indexed.empty() ? sampler.pixels : PixelBuffer(sampler.source, 1, _sourceLayout(sampler.source));
+}
+
+//  a + (b - a) * w / 256 per channel for w in [0, 256], two channels per multiply
+inline uint32_t _lerpPixel(uint32_t a, uint32_t b, uint32_t w)
+{
+    uint32_t rb = (((a & 0x00FF00FF) * (256 - w) + (b & 0x00FF00FF) * w) >> 8) & 0x00FF00FF;
+    uint32_t ag = (((a >> 8) & 0x00FF00FF) * (256 - w) + ((b >> 8) & 0x00FF00FF) * w) & 0xFF00FF00;
+    return rb | ag;
+}
+
+//  the line of pixels line[0], line[stride], ... line[last * stride] at pos, which is clamped
+//  to the line so that the passes blend in the edge pixels like a clamped border
+inline uint32_t _shearTap(const uint32_t* line, int stride, int last, float pos, _ShearFilter filter)
+{
+    pos = std::min(std::max(pos, 0.0f), (float)last);
+    if (filter == SHEAR_NEAREST)
+        return line[(int)(pos + 0.5f) * stride];
+    int i = (int)pos;
+    uint32_t w = (uint32_t)((pos - i) * 256);
+    return _lerpPixel(line[i * stride], line[std::min(i + 1, last) * stride], w);
+}
+
+inline bool _insideSource(vec2 p, int width, int height)
+{
+    return p.x >= 0 && p.y >= 0 && p.x < width && p.y < height;
+}
+
+//  narrows [begin, end) to the i where start + i * step lies in [lo, hi]
+void _narrowSpan(float start, float step, float lo, float hi, int& begin, int& end)
+{
+    if (step == 0)
+    {
+        if (start < lo || start > hi)
+            end = begin;
+        return;
+    }
+    float first = (lo - start) / step;
+    float last = (hi - start) / step;
+    if (step < 0)
+        std::swap(first, last);
+    begin = std::max(begin, (int)ceil(std::min(std::max(first, (float)begin), (float)end)));
+    end = std::max(begin, std::min(end, (int)floor(std::max(std::min(last, (float)end), (float)begin - 1)) + 1));
+}
+
+//  Draws a rotation as three shears (Paeth), each resampling whole rows or columns:
+//      1. row pass, every row of the source scaled and moved along itself
+//      2. column pass, every column scaled and moved along itself
+//      3. row pass, every row moved along itself
+//  With a = -tan(angle / 2) the steps are s * (cos, sin) and s * (-sin, cos) for
+//      pass 3: (x, y)  -> (x + a * y, y)
+//      pass 2: (u, y)  -> (u, s * sin * u + s * y + origin.y)
+//      pass 1: (u, v)  -> (s * u + a * v + origin.x - a * origin.y, v)
+//  Beyond a quarter turn the shears grow without bound, so those rotations read the source
+//  turned by half a turn instead. Pass 1 goes over the whole source, passes 2 and 3 go a
+//  target row at a time over just the pixels that map inside the source, the others are
+//  blank like sampling.
+void _drawShearRotation(const PixelBuffer& pixels, const _Rotation& rotation, _ShearFilter filter, Surface& result)
+{
+    int width = result.getWidth();
+    int height = result.getHeight();
+    int srcWidth = pixels.getWidth();
+    int srcHeight = pixels.getHeight();
+    if (width <= 0 || height <= 0 || srcWidth <= 0 || srcHeight <= 0)
+        return;
+
+    bool halfTurn = rotation.stepX.x < 0;
+    vec2 stepX = halfTurn ? -rotation.stepX : rotation.stepX;
+    vec2 origin = halfTurn ? vec2(srcWidth - 1, srcHeight - 1) - rotation.origin : rotation.origin;
+    float scale = length(stepX);
+    float angle = atan2(stepX.y, stepX.x);
+    float a = -tan(angle * 0.5f);
+    float b = scale * sin(angle);
+    float shiftX = origin.x - a * origin.y;
+
+    //  columns of the sheared source, enough for every shifted target row
+    int columnsBegin = (int)floor(std::min(0.0f, a * (height - 1))) - 1;
+    int columnsEnd = (int)ceil(width - 1 + std::max(0.0f, a * (height - 1))) + 2;
+    int columns = columnsEnd - columnsBegin;
+    std::unique_ptr<uint32_t[]> rows(new uint32_t[columns * srcHeight]);
+
+    //  Pass 2 reads the columns of pixels mapping up to two steps outside the source, and
+    //  clamps to the rows of the source, which moves up to as far again along them. Pass 1
+    //  fills that much, so that no pass reads what the one before left out.
+    float margin = 4 * scale + 8;
+    const PixelAddressing& addressing = pixels.getAddressing();
+    parallelFor(srcHeight, [&](int v)
+    {
+        std::vector<uint32_t> line(srcWidth);
+        int sy = halfTurn ? srcHeight - 1 - v : v;
+        for (int x = 0; x < srcWidth; x++)
+            line[x] = *addressing(halfTurn ? srcWidth - 1 - x : x, sy);
+        uint32_t* out = &rows[v * columns];
+        float start = scale * columnsBegin + a * v + shiftX;
+        int begin = 0;
+        int end = columns;
+        _narrowSpan(start, scale, -margin, srcWidth - 1 + margin, begin, end);
+        for (int i = begin; i < end; i++)
+            out[i] = _shearTap(&line[0], 1, srcWidth - 1, start + scale * i, filter);
+    });
+
+    parallelFor(height, [&](int y)
+    {
+        //  the span of the row inside the source, found once with only its ends tested
+        vec2 p = rotation.origin + (float)y * rotation.stepY;
+        int begin = 0;
+        int end = width;
+        _narrowSpan(p.x, rotation.stepX.x, -1, (float)srcWidth, begin, end);
+        _narrowSpan(p.y, rotation.stepX.y, -1, (float)srcHeight, begin, end);
+        for (; begin < end; begin++)
+            if (_insideSource(p + (float)begin * rotation.stepX, srcWidth, srcHeight))
+                break;
+        for (; end > begin; end--)
+            if (_insideSource(p + (float)(end - 1) * rotation.stepX, srcWidth, srcHeight))
+                break;
+
+        //  the whole row moves by the same amount, every pixel blends its pair with one weight
+        float start = a * y - columnsBegin;
+        int k = (int)floor(filter == SHEAR_NEAREST ? start + 0.5f : start);
+        uint32_t w = (uint32_t)((start - floor(start)) * 256);
+        int last = (filter == SHEAR_NEAREST) ? end - 1 : end;
+        std::vector<uint32_t> sheared(end - begin + 1);
+        for (int x = begin; x <= last && begin < end; x++)
+        {
+            int i = k + x;
+            sheared[x - begin] = _shearTap(&rows[i], columns, srcHeight - 1, b * (columnsBegin + i) + scale * y + origin.y, filter);
+        }
+
+        std::vector<uint32_t> row(width, BLANK_PIXEL);
+        for (int x = begin; x < end; x++)
+            row[x] = (filter == SHEAR_NEAREST) ? sheared[x - begin] : _lerpPixel(sheared[x - begin], sheared[x - begin + 1], w);
+        storeRow(result, 0, y, &row[0], width);
+    });
+}
+
+//  Catmull-Rom weights (the ones _cubicInterpolate of the bicubic sampler applies) for 257 sub-pixel phases 0..1
+struct CatmullRomTable
+{
+    CatmullRomTable()
+    {
+        for (int i = 0; i <= 256; i++)
+        {
+            float t = i / 256.0f;
+            weights[i][0] = 0.5f * (-t + 2*t*t - t*t*t);
+            weights[i][1] = 0.5f * (2 - 5*t*t + 3*t*t*t);
+            weights[i][2] = 0.5f * (t + 4*t*t - 3*t*t*t);
+            weights[i][3] = 0.5f * (-t*t + t*t*t);
+        }
+    }
+    float weights[257][4];
+};
+static const CatmullRomTable CATMULL_ROM;
+
+//  The same weights in 2.14 fixed point for TransformOptions::fixedPoint. 2 * 256^3 times
+//  each weight is an integer, that is rounded to 14 fraction bits and the largest weight
+//  takes up what is left of 1, so flat areas stay exact. pairs holds weights 0, 1 and 2, 3
+//  as the 16 bit pairs _mm_madd_epi16 takes.
+struct FixedCatmullRomTable
+{
+    FixedCatmullRomTable()
+    {
+        for (int i = 0; i <= 256; i++)
+        {
+            int i2 = i * i;
+            int i3 = i2 * i;
+            int exact[4] = { -i * 65536 + 2 * i2 * 256 - i3,
+                             2 * 16777216 - 5 * i2 * 256 + 3 * i3,
+                             i * 65536 + 4 * i2 * 256 - 3 * i3,
+                             -i2 * 256 + i3 };
+            for (int k = 0; k < 4; k++)
+                weights[i][k] = (exact[k] + 1024) >> 11;
+            int largest = (i <= 128) ? 1 : 2;
+            weights[i][largest] = 16384 - (weights[i][0] + weights[i][1] + weights[i][2] + weights[i][3] - weights[i][largest]);
+            pairs[i][0] = int((uint32_t(weights[i][1]) << 16) | (uint32_t(weights[i][0]) & 0xFFFF));
+            pairs[i][1] = int((uint32_t(weights[i][3]) << 16) | (uint32_t(weights[i][2]) & 0xFFFF));
+        }
+    }
+    int weights[257][4];
+    int pairs[257][2];
+};
+static const FixedCatmullRomTable FIXED_CATMULL_ROM;
+
+#if defined(PP_SSE2)
+//  the four channels of a packed pixel as floats, in packed order (b, g, r, a)
+inline __m128 _loadChannels(uint32_t p)
+{
+    __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(p), zero), zero));
+}
+
+//  truncates and saturates the four channels back into a packed pixel
+inline uint32_t _packChannels(__m128 channels)
+{
+    __m128i c = _mm_cvttps_epi32(channels);
+    c = _mm_packs_epi32(c, c);
+    return _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+}
+#endif
+
+//  taps per axis of the samplers the two pass warp stands in for, 0 for the others
+template<class Sampler>
+int _separableTaps(const Sampler&)
+{
+    return 0;
+}
+
+int _separableTaps(const BilinearSampler&)
+{
+    return 2;
+}
+
+int _separableTaps(const BicubicSampler&)
+{
+    return 4;
+}
+
+//  true if no target column drifts more than maxDrift source pixels sideways per source row.
+//  The drift is largest at the corners or edges of the quad, it is checked there and at the
+//  center; it needs the rows to cross every column in the same direction.
+bool _findSeparable(TransformMethod method, TransformMapping& srcMapping, TransformMapping& destMapping, float maxDrift)
+{
+    if (method != TM_PROJECTIVE && method != TM_ROTATE_SHEAR)
+        return false;
+
+    _TargetToSource targetToSource(method, srcMapping, destMapping);
+    const vec2* quad = destMapping.localQuad;
+    vec2 points[9];
+    for (int i = 0; i < 4; i++)
+    {
+        points[i] = quad[i];
+        points[i + 4] = (quad[i] + quad[(i + 1) % 4]) * 0.5f;
+    }
+    points[8] = (quad[0] + quad[1] + quad[2] + quad[3]) * 0.25f;
+    float direction = 0;
+    for (int i = 0; i < 9; i++)
+    {
+        vec2 q = points[i];
+        float down = targetToSource(q.x, q.y + 1).y - targetToSource(q.x, q.y).y;
+        if (!(down * direction >= 0) || down == 0)
+            return false;
+        direction = down;
+        float v = targetToSource(q.x, q.y).y;
+        float drift = targetToSource.crossRow(q.x, v + 1) - targetToSource.crossRow(q.x, v);
+        if (!(fabs(drift) <= maxDrift))
+            return false;
+    }
+    return true;
+}
+
+//  Catmull-Smith warp: a row pass resamples every source row at the points where the target
+//  columns cross it, a column pass resamples those down each target column. Both use the
+//  phases and weights of the direct samplers, only the rows of a footprint are no longer read
+//  at the same x. The target goes in strips of TILE_SIZE columns, each with the intermediate
+//  rows it needs.
+void _drawSeparable(const PixelBuffer& pixels, int taps, TransformMethod method, TransformMapping& srcMapping,
+                    TransformMapping& destMapping, Surface& result)
+{
+    int width = result.getWidth();
+    int height = result.getHeight();
+    int srcWidth = pixels.getWidth();
+    int srcHeight = pixels.getHeight();
+    if (width <= 0 || height <= 0)
+        return;
+
+    _TargetToSource targetToSource(method, srcMapping, destMapping);
+    const PixelAddressing& addressing = pixels.getAddressing();
+    int above = (taps == 4) ? 1 : 0;    // rows of a footprint above the row of its sample
+    int below = taps - 1 - above;
+    int strips = (width + TILE_SIZE - 1) / TILE_SIZE;
+    parallelFor(strips, [&](int strip)
+    {
+        int x0 = strip * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, width);
+        int count = x1 - x0;
+
+        //  a projective mapping is extreme at the corners, so these source rows cover the strip
+        float top = srcHeight;
+        float bottom = 0;
+        float corners[4][2] = { { (float)x0, 0 }, { (float)x1, 0 }, { (float)x0, (float)height }, { (float)x1, (float)height } };
+        for (int i = 0; i < 4; i++)
+        {
+            float v = targetToSource(corners[i][0], corners[i][1]).y;
+            top = std::min(top, v);
+            bottom = std::max(bottom, v);
+        }
+        int row0 = std::max(-above, (int)floor(std::max(top, -1.0f)) - above);
+        int row1 = std::min(srcHeight - 1 + below, (int)floor(std::min(bottom, (float)srcHeight)) + below);
+        if (row1 < row0)
+            row1 = row0;
+
+        //  row pass, 4 channels per pixel in packed order. The bilinear sums are the halved
+        //  integers of the direct sampler, which floats hold exactly.
+        int rowFloats = count * 4;
+        std::vector<float> rows((row1 - row0 + 1) * rowFloats);
+        float xs[TILE_SIZE];
+        for (int v = row0; v <= row1; v++)
+        {
+            targetToSource.crossRow(v, x0, count, xs);
+            float* out = &rows[(v - row0) * rowFloats];
+            for (int i = 0; i < count; i++, out += 4)
+            {
+                //  columns that only cross the row outside the source read the padding there
+                float x = xs[i];
+                if (!(x >= -1))
+                    x = -1;
+                if (!(x < srcWidth))
+                    x = srcWidth;
+                float scaledX = x * 512.0f;
+                int fixedX = static_cast<int>(scaledX);
+                fixedX = std::min(fixedX - (scaledX < fixedX ? 1 : 0), srcWidth * 512 - 1);
+                int phase = ((fixedX & 0x1FF) + 1) >> 1;
+                const uint32_t* p = addressing(fixedX >> 9, v);
+                if (taps == 2)
+                {
+#if defined(PP_SSE2)
+                    __m128 sum = _mm_add_ps(_mm_mul_ps(_loadChannels(p[0]), _mm_set1_ps(0.5f * (256 - phase))),
+                                            _mm_mul_ps(_loadChannels(p[1]), _mm_set1_ps(0.5f * phase)));
+                    _mm_storeu_ps(out, _mm_cvtepi32_ps(_mm_cvttps_epi32(sum)));
+#else
+                    for (int c = 0; c < 4; c++)
+                        out[c] = (float)(((0xFF & (p[0] >> (8 * c))) * (256 - phase) + (0xFF & (p[1] >> (8 * c))) * phase) >> 1);
+#endif
+                }
+                else
+                {
+                    const float* w = CATMULL_ROM.weights[phase];
+#if defined(PP_SSE2)
+                    _mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_loadChannels(p[-1]), _mm_set1_ps(w[0])),
+                                                             _mm_mul_ps(_loadChannels(p[0]), _mm_set1_ps(w[1]))),
+                                                  _mm_add_ps(_mm_mul_ps(_loadChannels(p[1]), _mm_set1_ps(w[2])),
+                                                             _mm_mul_ps(_loadChannels(p[2]), _mm_set1_ps(w[3])))));
+#else
+                    for (int c = 0; c < 4; c++)
+                    {
+                        int shift = 8 * c;
+                        out[c] = w[0] * (0xFF & (p[-1] >> shift)) + w[1] * (0xFF & (p[0] >> shift))
+                               + w[2] * (0xFF & (p[1] >> shift)) + w[3] * (0xFF & (p[2] >> shift));
+                    }
+#endif
+                }
+            }
+        }
+
+        //  column pass, with blank tiles skipped and the direct mapping deciding what is inside
+        float ys[TILE_SIZE];
+        uint32_t row[TILE_SIZE];
+        for (int y0 = 0; y0 < height; y0 += TILE_SIZE)
+        {
+            int y1 = std::min(y0 + TILE_SIZE, height);
+            bool outside = _tileOutsideQuad(destMapping.localQuad, x0, y0, x1, y1);
+            for (int y = y0; y < y1; y++)
+            {
+                std::fill(row, row + count, BLANK_PIXEL);
+                if (!outside)
+                {
+                    targetToSource.mapRow(y, x0, count, xs, ys);
+                    for (int i = 0; i < count; i++)
+                    {
+                        if (!(xs[i] >= 0 && ys[i] >= 0 && xs[i] < srcWidth && ys[i] < srcHeight))
+                            continue;
+                        int fixedY = static_cast<int>(ys[i] * 512.0f);
+                        int phase = ((fixedY & 0x1FF) + 1) >> 1;
+                        const float* in = &rows[((fixedY >> 9) - above - row0) * rowFloats + i * 4];
+                        uint32_t pixel = 0;
+                        if (taps == 2)
+                        {
+#if defined(PP_SSE2)
+                            __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in), _mm_set1_ps(float(256 - phase))),
+                                                    _mm_mul_ps(_mm_loadu_ps(in + rowFloats), _mm_set1_ps(float(phase))));
+                            pixel = _packChannels(_mm_mul_ps(sum, _mm_set1_ps(1.0f / 32768)));
+#else
+                            for (int c = 0; c < 4; c++)
+                                pixel |= uint32_t(((int)in[c] * (256 - phase) + (int)in[c + rowFloats] * phase) >> 15) << (8 * c);
+#endif
+                        }
+                        else
+                        {
+                            const float* w = CATMULL_ROM.weights[phase];
+#if defined(PP_SSE2)
+                            __m128 sum = _mm_setzero_ps();
+                            for (int j = 0; j < 4; j++)
+                                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + j * rowFloats), _mm_set1_ps(w[j])));
+                            pixel = _packChannels(_mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), _mm_set1_ps(255.0f)));
+#else
+                            for (int c = 0; c < 4; c++)
+                            {
+                                float sum = 0;
+                                for (int j = 0; j < 4; j++)
+                                    sum += in[c + j * rowFloats] * w[j];
+                                pixel |= uint32_t(constrain(sum, 0.0f, 255.0f)) << (8 * c);
+                            }
+#endif
+                        }
+                        row[i] = pixel;
+                    }
+                }
+                storeRow(result, x0, y, row, count);
+            }
+        }
+    });
+}
+
+template<class Sampler>
+void _supersample(Sampler& sampler, TransformMapping& srcMapping, TransformMapping& destMapping, TransformMethod method,
+                  const TransformOptions& options, Surface& result)
+{
+    int width = result.getWidth();
+    int height = result.getHeight();
+    if (width <= 0 || height <= 0)
+        return;
+
+    //  first pass: one sample per pixel, kept with a clamped border for the edge test
+    int stride = width + 2;
+    std::vector<uint32_t> coarse(stride * (height + 2));
+    uint32_t* origin = &coarse[stride + 1];
+    auto drawCoarse = [&](int y, int x, int count, const float* xs, const float* ys, const float* nextXs, const float* nextYs)
+    {
+        if (options.fixedPoint)
+            _sampleRowFixed(sampler, xs, ys, nextXs, nextYs, count, origin + y * stride + x);
+        else
+            _sampleRow(sampler, xs, ys, nextXs, nextYs, count, origin + y * stride + x);
+    };
+    auto clearCoarse = [&](int y, int x, int count)
+    {
+        std::fill(origin + y * stride + x, origin + y * stride + x + count, BLANK_PIXEL);
+    };
+    if (options.fixedPoint)
+        _drawTiles(CoordinateMap(sampler.source.getBounds(), destMapping, method, true), drawCoarse, clearCoarse);
+    else
+        _drawTiles(method, srcMapping, destMapping, width, height, drawCoarse, clearCoarse);
+    for (int y = 0; y < height; y++)
+    {
+        uint32_t* row = origin + y * stride;
+        row[-1] = row[0];
+        row[width] = row[width - 1];
+    }
+    std::copy(origin - 1, origin - 1 + stride, origin - 1 - stride);
+    std::copy(origin - 1 + (height - 1) * stride, origin - 1 + height * stride, origin - 1 + height * stride);
+
+    //  second pass: resample edge pixels on an n x n grid centered on the pixel
+    int n = options.supersampling;
+    int perPixel = n * n;
+    std::vector<float> offsets(n);
+    for (int i = 0; i < n; i++)
+        offsets[i] = (i + 0.5f) / n - 0.5f;
+
+    _TargetToSource targetToSource(method, srcMapping, destMapping);
+    _FixedTargetToSource fixedToSource(method, srcMapping, destMapping);
+    bool alpha = result.hasAlpha();
+    parallelFor(height, [&](int y)
+    {
+        const uint32_t* coarseRow = origin + y * stride;
+        std::vector<int> edges;
+        for (int x = 0; x < width; x++)
+            if (_isEdge(coarseRow + x, stride, options.edgeThreshold))
+                edges.push_back(x);
+
+        std::vector<uint32_t> row(coarseRow, coarseRow + width);
+        if (!edges.empty())
+        {
+            int count = (int)edges.size() * perPixel;
+            std::vector<float> xs(count);
+            std::vector<float> ys(count);
+            std::vector<uint32_t> samples(count);
+            int k = 0;
+            for (size_t e = 0; e < edges.size(); e++)
+                for (int j = 0; j < n; j++)
+                    for (int i = 0; i < n; i++, k++)
+                    {
+                        float tx = edges[e] + offsets[i];
+                        float ty = y + offsets[j];
+                        vec2 p = options.fixedPoint ? fixedToSource(tx, ty) : targetToSource(tx, ty);
+                        xs[k] = p.x;
+                        ys[k] = p.y;
+                    }
+            if (options.fixedPoint)
+                _sampleRowFixed(sampler, &xs[0], &ys[0], count, &samples[0]);
+            else
+                _sampleRow(sampler, &xs[0], &ys[0], count, &samples[0]);
+            for (size_t e = 0; e < edges.size(); e++)
+                row[edges[e]] = averagePixels(&samples[e * perPixel], perPixel, alpha);
+        }
+        storeRow(result, 0, y, &row[0], width);
+    });
+}
+
+//  pixels a sampler footprint reaches beyond the rounded sample position
+const int FOOTPRINT_MARGIN = 3;
+
+//  samplers that take the same sample anywhere on a footprint of a single color, so that
+//  one sample stands for all of a row falling in such a region. Nearest neighbour would,
+//  but its sample is a single load and costs no more than finding out.
+template<class Sampler>
+bool _samplesFlatAlike(const Sampler&, bool)
+{
+    return false;
+}
+
+bool _samplesFlatAlike(const BilinearSampler&, bool)
+{
+    return true;
+}
+
+//  the float weights only about sum to one, the integer ones exactly
+bool _samplesFlatAlike(const BicubicSampler&, bool fixedPoint)
+{
+    return fixedPoint;
+}
+
+bool _samplesFlatAlike(const BilinearDominanceSampler&, bool)
+{
+    return true;
+}
+
+bool _samplesFlatAlike(const WeightSampler&, bool)
+{
+    return true;
+}
+
+//  local candidates all are the color, the palette one nearest to the interpolation is not
+bool _samplesFlatAlike(const BicubicBestFitSampler& sampler, bool)
+{
+    return sampler.mode != BicubicBestFitSampler::PALETTE;
+}
+
+//  row callbacks of _drawTiles that sample into result; rows whose samples all fall in one
+//  color of uniform, or outside the source, take a single sample
+template<class Sampler>
+struct _SampleInto
+{
+    _SampleInto(Sampler& sampler, Surface& result, bool fixedPoint = false) : sampler(sampler), result(result), fixedPoint(fixedPoint)
+    {
+        if (_samplesFlatAlike(sampler, fixedPoint))
+            uniform = std::make_shared<UniformBlocks>(_packedPixels(sampler));
+    }
+
+    void operator()(int y, int x, int count, const float* xs, const float* ys, const float* nextXs, const float* nextYs) const
+    {
+        uint32_t row[TILE_SIZE];
+        if (!uniform || !sampleUniform(count, xs, ys, nextXs, nextYs, row))
+        {
+            if (fixedPoint)
+                _sampleRowFixed(sampler, xs, ys, nextXs, nextYs, count, row);
+            else
+                _sampleRow(sampler, xs, ys, nextXs, nextYs, count, row);
+        }
+        storeRow(result, x, y, row, count);
+    }
+
+    void operator()(int y, int x, int count) const
+    {
+        uint32_t row[TILE_SIZE] = { BLANK_PIXEL };
+        storeRow(result, x, y, row, count);
+    }
+
+    bool sampleUniform(int count, const float* xs, const float* ys, const float* nextXs, const float* nextYs, uint32_t* row) const
+    {
+        float width = (float)sampler.source.getWidth();
+        float height = (float)sampler.source.getHeight();
+        float minX = width;
+        float minY = height;
+        float maxX = 0;
+        float maxY = 0;
+        int first = -1;
+        for (int i = 0; i < count; i++)
+            if (xs[i] >= 0 && ys[i] >= 0 && xs[i] < width && ys[i] < height)
+            {
+                first = (first < 0) ? i : first;
+                minX = std::min(minX, xs[i]);
+                maxX = std::max(maxX, xs[i]);
+                minY = std::min(minY, ys[i]);
+                maxY = std::max(maxY, ys[i]);
+            }
+
+        uint32_t sample = BLANK_PIXEL;
+        if (first >= 0)
+        {
+            uint32_t color;
+            if (!uniform->isUniform((int)minX - FOOTPRINT_MARGIN, (int)minY - FOOTPRINT_MARGIN,
+                                    (int)maxX + FOOTPRINT_MARGIN, (int)maxY + FOOTPRINT_MARGIN, color))
+                return false;
+            if (fixedPoint)
+                _sampleRowFixed(sampler, xs + first, ys + first, nextXs + first, nextYs + first, 1, &sample);
+            else
+                _sampleRow(sampler, xs + first, ys + first, nextXs + first, nextYs + first, 1, &sample);
+        }
+        for (int i = 0; i < count; i++)
+            row[i] = (xs[i] >= 0 && ys[i] >= 0 && xs[i] < width && ys[i] < height) ? sample : BLANK_PIXEL;
+        return true;
+    }
+
+    Sampler& sampler;
+    Surface& result;
+    bool fixedPoint;
+    std::shared_ptr<UniformBlocks> uniform;     // null unless the sampler takes flat samples alike
+};
+
+template<class Sampler>
+Surface pp::transform(Sampler& sampler, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options)
+{
+    if (method == TM_IDENTITY)
+        return sampler.source;
+
+    Surface result(targetMapping.bounds.getWidth(), targetMapping.bounds.getHeight(), sampler.source.hasAlpha());
+    TransformMapping srcMapping(sampler.source.getBounds());
+    if (options.supersampling > 1)
+    {
+        _supersample(sampler, srcMapping, targetMapping, method, options, result);
+        return result;
+    }
+
+    //  none of the float shortcuts below
+    if (options.fixedPoint)
+        return transform(sampler, CoordinateMap(sampler.source.getBounds(), targetMapping, method, true), options);
+
+    _PixelPermutation permutation;
+    if (_exactOnPixels(sampler) && _findPermutation(method, srcMapping, targetMapping, permutation))
+    {
+        _drawPermutation(sampler.pixels, permutation, result);
+        return result;
+    }
+
+    _Rotation rotation;
+    if (method == TM_ROTATE_SHEAR && _shearFilter(sampler) != SHEAR_NONE && _findRotation(method, srcMapping, targetMapping, rotation))
+    {
+        _drawShearRotation(_packedPixels(sampler), rotation, _shearFilter(sampler), result);
+        return result;
+    }
+
+    if (options.separableDrift > 0 && _separableTaps(sampler) > 0 && _findSeparable(method, srcMapping, targetMapping, options.separableDrift))
+    {
+        _drawSeparable(sampler.pixels, _separableTaps(sampler), method, srcMapping, targetMapping, result);
+        return result;
+    }
+
+    _SampleInto<Sampler> sampleInto(sampler, result);
+    _drawTiles(method, srcMapping, targetMapping, result.getWidth(), result.getHeight(), sampleInto, sampleInto);
+    return result;
+}
+
+template<class Sampler>
+Surface pp::transform(Sampler& sampler, const CoordinateMap& coordinates, const TransformOptions& options)
+{
+    assert(coordinates.getSourceBounds() == sampler.source.getBounds());
+    TransformMapping targetMapping = coordinates.getTargetMapping();
+    TransformMethod method = coordinates.getMethod();
+    if (method == TM_IDENTITY)
+        return sampler.source;
+
+    if (options.fixedPoint)
+    {
+        if (options.supersampling > 1 || !coordinates.isFixedPoint())
+            return transform(sampler, targetMapping, method, options);
+        Surface result(coordinates.getWidth(), coordinates.getHeight(), sampler.source.hasAlpha());
+        _SampleInto<Sampler> sampleInto(sampler, result, true);
+        _drawTiles(coordinates, sampleInto, sampleInto);
+        return result;
+    }
+
+    //  supersampling maps between the pixels, copies, shears and two pass warps need no coordinates
+    TransformMapping srcMapping(sampler.source.getBounds());
+    _PixelPermutation permutation;
+    _Rotation rotation;
+    if (options.supersampling > 1 || (_exactOnPixels(sampler) && _findPermutation(method, srcMapping, targetMapping, permutation)) ||
+        (method == TM_ROTATE_SHEAR && _shearFilter(sampler) != SHEAR_NONE && _findRotation(method, srcMapping, targetMapping, rotation)) ||
+        (options.separableDrift > 0 && _separableTaps(sampler) > 0 && _findSeparable(method, srcMapping, targetMapping, options.separableDrift)))
+        return transform(sampler, targetMapping, method, options);
+
+    Surface result(coordinates.getWidth(), coordinates.getHeight(), sampler.source.hasAlpha());
+    _SampleInto<Sampler> sampleInto(sampler, result);
+    _drawTiles(coordinates, sampleInto, sampleInto);
+    return result;
+}
+
+//  points the sampler at another source, keeping its settings
+template<class Sampler>
+void _rebase(Sampler& sampler, Surface& source)
+{
+    sampler.source = source;
+    sampler.pixels = PixelBuffer(source, sampler.pixels.getPadding(), _sourceLayout(source), sampler.pixels.getBorder());
+}
+
+void _rebase(AreaSampler& sampler, Surface& source)
+{
+    sampler = AreaSampler(source);
+}
+
+//  the color indices go with the pixels
+void _rebase(BilinearDominanceSampler& sampler, Surface& source)
+{
+    sampler = BilinearDominanceSampler(source, sampler.order);
+}
+
+void _rebase(WeightSampler& sampler, Surface& source)
+{
+    sampler = WeightSampler(source, sampler.order);
+}
+
+//  samplers that give the same result on any region holding their footprints; mip levels
+//  average blocks aligned to the source and wrapped borders reach across it
+template<class Sampler>
+bool _samplesRegions(const Sampler& sampler)
+{
+    return sampler.pixels.getBorder() != PixelBuffer::BORDER_WRAP;
+}
+
+bool _samplesRegions(const AreaSampler&)
+{
+    return false;
+}
+
+//  indexing the colors of every tile's region costs more than scaling first and indexing once
+bool _samplesRegions(const BilinearDominanceSampler&)
+{
+    return false;
+}
+
+bool _samplesRegions(const WeightSampler&)
+{
+    return false;
+}
+
+template<class Sampler>
+Surface pp::transformScaled(Sampler& sampler, ScaleMethod scaleMethod, TransformMapping& targetMapping, TransformMethod method,
+                            const TransformOptions& options)
+{
+    if (method == TM_IDENTITY)
+        return scale(sampler.source, scaleMethod);
+
+    if (!isLocalScale(scaleMethod) || options.supersampling > 1 || options.fixedPoint || !_samplesRegions(sampler))
+    {
+        Surface scaled = scale(sampler.source, scaleMethod);
+        Sampler whole(sampler);
+        _rebase(whole, scaled);
+        return transform(whole, targetMapping, method, options);
+    }
+
+    int factor = scaleFactor(scaleMethod);
+    int scaledWidth = sampler.source.getWidth() * factor;
+    int scaledHeight = sampler.source.getHeight() * factor;
+    int width = targetMapping.bounds.getWidth();
+    int height = targetMapping.bounds.getHeight();
+    Surface result(width, height, sampler.source.hasAlpha());
+    TransformMapping srcMapping(Area(0, 0, scaledWidth, scaledHeight));
+    _TargetToSource targetToSource(method, srcMapping, targetMapping);
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    parallelFor(tilesX * tilesY, [&](int tile)
+    {
+        int x0 = (tile % tilesX) * TILE_SIZE;
+        int y0 = (tile / tilesX) * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, width);
+        int y1 = std::min(y0 + TILE_SIZE, height);
+        int count = x1 - x0;
+        int stride = count + 1;
+        uint32_t row[TILE_SIZE] = { BLANK_PIXEL };
+        if (_tileOutsideQuad(targetMapping.localQuad, x0, y0, x1, y1))
+        {
+            for (int y = y0; y < y1; y++)
+                storeRow(result, x0, y, row, count);
+            return;
+        }
+
+        //  coordinates of the tile and the row below, and the scaled region they fall in
+        std::vector<float> xs(stride * (y1 - y0 + 1));
+        std::vector<float> ys(stride * (y1 - y0 + 1));
+        for (int y = y0; y <= y1; y++)
+            targetToSource.mapRow(y, x0, stride, &xs[(y - y0) * stride], &ys[(y - y0) * stride]);
+        float minX = (float)scaledWidth;
+        float minY = (float)scaledHeight;
+        float maxX = 0;
+        float maxY = 0;
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            minX = std::min(minX, xs[i]);
+            maxX = std::max(maxX, xs[i]);
+            minY = std::min(minY, ys[i]);
+            maxY = std::max(maxY, ys[i]);
+        }
+        Area region((int)floor(std::max(minX, 0.0f)) - FOOTPRINT_MARGIN, (int)floor(std::max(minY, 0.0f)) - FOOTPRINT_MARGIN,
+                    (int)ceil(std::min(maxX, (float)scaledWidth)) + FOOTPRINT_MARGIN, (int)ceil(std::min(maxY, (float)scaledHeight)) + FOOTPRINT_MARGIN);
+        region.x1 = std::max(region.x1, 0);
+        region.y1 = std::max(region.y1, 0);
+        region.x2 = std::min(region.x2, scaledWidth);
+        region.y2 = std::min(region.y2, scaledHeight);
+        if (region.x1 >= region.x2 || region.y1 >= region.y2)
+        {
+            for (int y = y0; y < y1; y++)
+                storeRow(result, x0, y, row, count);
+            return;
+        }
+
+        //  the shift to the region is exact, so the samples are those of the whole image
+        Surface part = scaleRegion(sampler.source, scaleMethod, region);
+        Sampler local(sampler);
+        _rebase(local, part);
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            xs[i] -= region.x1;
+            ys[i] -= region.y1;
+        }
+        for (int y = y0; y < y1; y++)
+        {
+            int k = (y - y0) * stride;
+            _sampleRow(local, &xs[k], &ys[k], &xs[k + stride], &ys[k + stride], count, row);
+            storeRow(result, x0, y, row, count);
+        }
+    });
+    return result;
+}
+
+template<class Sampler>
+std::vector<Surface> pp::transformFrames(Sampler& sampler, ScaleMethod scaleMethod, std::vector<TransformMapping>& targetMappings,
+                                         TransformMethod method, const TransformOptions& options)
+{
+    //  one scaled source and one padded buffer, palette index or mip pyramid for all frames
+    Sampler whole(sampler);
+    if (scaleMethod != SM_NONE)
+    {
+        Surface scaled = scale(sampler.source, scaleMethod);
+        _rebase(whole, scaled);
+    }
+
+    //  with a frame for every core the frames go in parallel, else each frame its tiles
+    std::vector<Surface> frames(targetMappings.size());
+    int count = (int)frames.size();
+    auto drawFrame = [&](int i)
+    {
+        frames[i] = transform(whole, targetMappings[i], method, options);
+    };
+    if (count >= (int)std::thread::hardware_concurrency())
+        parallelFor(count, drawFrame);
+    else
+        for (int i = 0; i < count; i++)
+            drawFrame(i);
+    return frames;
+}
+
+//  row callbacks of _drawTiles that sample both dominant colors and their weights into three surfaces
+struct _DominanceInto
+{
+    _DominanceInto(BilinearDominanceSetSampler& sampler, Surface& first, Surface& second, Surface& weights)
+    :   sampler(sampler), first(first), second(second), weights(weights) {}
+
+    void operator()(int y, int x, int count, const float* xs, const float* ys, const float*, const float*) const
+    {
+        DominanceSample samples[TILE_SIZE];
+        uint32_t row[TILE_SIZE];
+        sampler.sampleRow(xs, ys, count, samples);
+        for (int i = 0; i < count; i++)
+            row[i] = samples[i].first;
+        storeRow(first, x, y, row, count);
+        for (int i = 0; i < count; i++)
+            row[i] = samples[i].second;
+        storeRow(second, x, y, row, count);
+        for (int i = 0; i < count; i++)
+            row[i] = 0xFF000000 | (samples[i].firstWeight << 16) | (samples[i].secondWeight << 8);
+        storeRow(weights, x, y, row, count);
+    }
+
+    //  what sampleRow() gives outside the source
+    void operator()(int y, int x, int count) const
+    {
+        uint32_t row[TILE_SIZE] = { BLANK_PIXEL };
+        storeRow(first, x, y, row, count);
+        storeRow(second, x, y, row, count);
+        std::fill(row, row + count, 0xFF000000);
+        storeRow(weights, x, y, row, count);
+    }
+
+    BilinearDominanceSetSampler& sampler;
+    Surface& first;
+    Surface& second;
+    Surface& weights;
+};
+
+void pp::transformDominance(BilinearDominanceSetSampler& sampler, TransformMapping& targetMapping, TransformMethod method,
+                            Surface& first, Surface& second, Surface& weights)
+{
+    TransformMapping srcMapping(sampler.source.getBounds());
+    //  without a transform every pixel maps onto itself
+    TransformMapping destMapping = (method == TM_IDENTITY) ? srcMapping : targetMapping;
+    if (method == TM_IDENTITY)
+        method = TM_PROJECTIVE;
+
+    int width = destMapping.bounds.getWidth();
+    int height = destMapping.bounds.getHeight();
+    first = Surface(width, height, sampler.source.hasAlpha());
+    second = Surface(width, height, sampler.source.hasAlpha());
+    weights = Surface(width, height, false);
+    _DominanceInto dominanceInto(sampler, first, second, weights);
+    _drawTiles(method, srcMapping, destMapping, width, height, dominanceInto, dominanceInto);
+}
+
+void pp::transformDominance(BilinearDominanceSetSampler& sampler, const CoordinateMap& coordinates,
+                            Surface& first, Surface& second, Surface& weights)
+{
+    assert(coordinates.getSourceBounds() == sampler.source.getBounds());
+    if (coordinates.getMethod() == TM_IDENTITY)
+    {
+        TransformMapping targetMapping = coordinates.getTargetMapping();
+        transformDominance(sampler, targetMapping, TM_IDENTITY, first, second, weights);
+        return;
+    }
+
+    int width = coordinates.getWidth();
+    int height = coordinates.getHeight();
+    first = Surface(width, height, sampler.source.hasAlpha());
+    second = Surface(width, height, sampler.source.hasAlpha());
+    weights = Surface(width, height, false);
+    _DominanceInto dominanceInto(sampler, first, second, weights);
+    _drawTiles(coordinates, dominanceInto, dominanceInto);
+}
+
+//  Lines of a streamed image kept in a ring, each with one clamped pixel either side so
+//  the 3x3 row kernels can read x-1 and x+1. line(y) clamps y to the image like getPixel.
+template<typename T>
+struct _LineRing
+{
+    _LineRing(int width, int height) : width(width), height(height), data(3 * (width + 2)) {}
+    T* line(int y)
+    {
+        y = std::max(0, std::min(y, height - 1));
+        return &data[(y % 3) * (width + 2) + 1];
+    }
+    void clampEdges(int y)
+    {
+        T* l = line(y);
+        l[-1] = l[0];
+        l[width] = l[width - 1];
+    }
+    int width;
+    int height;
+    std::vector<T> data;
+};
+
+//  streams the "Bilinear Mix" pipeline up to the threshold, handing each line to
+//  line(y, first, second, scores) once its swap scores are final
+template<class LineFn>
+void _streamMix(Surface& source, const CoordinateMap& coordinates, LineFn line)
+{
+    int width = coordinates.getWidth();
+    int height = coordinates.getHeight();
+
+    BicubicSampler bicubic(source);
+    BilinearDominanceSetSampler dominance(source);
+    std::vector<DominanceSample> samples(width);
+    std::vector<uint32_t> compared(width);
+    std::vector<float> scores(width);
+    //  rows y-2..y of the samples, rows y-3..y-1 of the squared errors
+    _LineRing<uint32_t> smooth(width, height);
+    _LineRing<uint32_t> first(width, height);
+    _LineRing<uint32_t> second(width, height);
+    _LineRing<uint32_t> weight(width, height);
+    _LineRing<int> errors(width, height);
+
+    //  compare() for line y needs samples y-1..y+1, choose() for line y errors y-1..y+1,
+    //  so each line is final two lines after it was sampled
+    auto compareLine = [&](int y)
+    {
+        const uint32_t* rowsA[3] = { smooth.line(y-1), smooth.line(y), smooth.line(y+1) };
+        const uint32_t* rowsB[3] = { first.line(y-1), first.line(y), first.line(y+1) };
+        compareRow(rowsA, rowsB, width, &compared[0]);
+        errorRow(&compared[0], width, errors.line(y));
+        errors.clampEdges(y);
+    };
+    auto scoreLine = [&](int y)
+    {
+        const int* errorRows[3] = { errors.line(y-1), errors.line(y), errors.line(y+1) };
+        scoreRow(errorRows, weight.line(y), width, &scores[0]);
+        line(y, first.line(y), second.line(y), &scores[0]);
+    };
+
+    for (int y = 0; y < height; y++)
+    {
+        const float* xs = coordinates.getXs(y);
+        const float* ys = coordinates.getYs(y);
+        bicubic.sampleRow(xs, ys, width, smooth.line(y));
+        dominance.sampleRow(xs, ys, width, &samples[0]);
+        uint32_t* f = first.line(y);
+        uint32_t* s = second.line(y);
+        uint32_t* w = weight.line(y);
+        for (int x = 0; x < width; x++)
+        {
+            f[x] = samples[x].first;
+            s[x] = samples[x].second;
+            w[x] = samples[x].firstWeight << 16;
+        }
+        smooth.clampEdges(y);
+        first.clampEdges(y);
+        if (y >= 1)
+            compareLine(y - 1);
+        if (y >= 2)
+            scoreLine(y - 2);
+    }
+    compareLine(height - 1);
+    for (int y = std::max(0, height - 2); y < height; y++)
+        scoreLine(y);
+}
+
+Surface pp::transformMix(Surface& source, TransformMapping& targetMapping, TransformMethod method, float threshold)
+{
+    return transformMix(source, CoordinateMap(source.getBounds(), targetMapping, method), threshold);
+}
+
+Surface pp::transformMix(Surface& source, const CoordinateMap& coordinates, float threshold)
+{
+    int width = coordinates.getWidth();
+    int height = coordinates.getHeight();
+    Surface result(width, height, false);
+    if (width <= 0 || height <= 0)
+        return result;
+
+    std::vector<uint32_t> chosen(width);
+    _streamMix(source, coordinates, [&](int y, const uint32_t* first, const uint32_t* second, const float* scores)
+    {
+        selectRow(first, second, scores, width, threshold, &chosen[0]);
+        storeRow(result, 0, y, &chosen[0], width);
+    });
+    return result;
+}
+
+SwapScores pp::mixScores(Surface& source, const CoordinateMap& coordinates)
+{
+    SwapScores result;
+    int width = coordinates.getWidth();
+    int height = coordinates.getHeight();
+    if (width <= 0 || height <= 0)
+        return result;
+
+    result.width = width;
+    result.height = height;
+    result.scores.resize(width * height);
+    result.imageA.resize(width * height);
+    result.imageB.resize(width * height);
+    _streamMix(source, coordinates, [&](int y, const uint32_t* first, const uint32_t* second, const float* scores)
+    {
+        std::copy(first, first + width, &result.imageA[y * width]);
+        std::copy(second, second + width, &result.imageB[y * width]);
+        std::copy(scores, scores + width, &result.scores[y * width]);
+    });
+    return result;
+}
+
+//  the pixel 'corner' (bit 0 right, bit 1 bottom) of Scale2x at e, from e and its
+//  neighbours above, left, right and below; the rules of _scale2x, which compares colors
+//  without alpha, but the chosen pixel keeps its alpha
+inline uint32_t _scale2xCorner(uint32_t e, uint32_t b, uint32_t d, uint32_t f, uint32_t h, int corner)
+{
+    const uint32_t rgb = 0x00FFFFFF;
+    if (((b ^ h) & rgb) == 0 || ((d ^ f) & rgb) == 0)
+        return e;
+    switch (corner)
+    {
+    case 0:
+        return ((d ^ b) & rgb) == 0 ? d : e;
+    case 1:
+        return ((b ^ f) & rgb) == 0 ? f : e;
+    case 2:
+        return ((d ^ h) & rgb) == 0 ? d : e;
+    default:
+        return ((h ^ f) & rgb) == 0 ? f : e;
+    }
+}
+
+//  RotSprite scales by 8 with three Scale2x passes. Each tile evaluates the first pass over
+//  the part of the source it samples, with one clamped pixel around it, and derives the
+//  second and third pass pixel of every sample from there. Sample coordinates are those of
+//  'coordinates' times toScaled, rounded like NearestNeighbourSampler.
+const int ROTSPRITE_FACTOR = 8;
+
+void _drawRotSprite(Surface& source, const CoordinateMap& coordinates, float toScaled, Surface& result)
+{
+    int width = coordinates.getWidth();
+    int height = coordinates.getHeight();
+    int srcWidth = source.getWidth();
+    int srcHeight = source.getHeight();
+    if (width <= 0 || height <= 0 || srcWidth <= 0 || srcHeight <= 0)
+        return;
+
+    PixelBuffer pixels(source, 1, _sourceLayout(source));
+    const PixelAddressing& addressing = pixels.getAddressing();
+    int stride = addressing.stride;
+    int lastX2 = 4 * srcWidth - 1;      // of the second pass
+    int lastY2 = 4 * srcHeight - 1;
+    float scaledWidth = (float)(ROTSPRITE_FACTOR * srcWidth);
+    float scaledHeight = (float)(ROTSPRITE_FACTOR * srcHeight);
+    const vec2* quad = coordinates.getTargetMapping().localQuad;
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    parallelFor(tilesX * tilesY, [&](int tile)
+    {
+        int x0 = (tile % tilesX) * TILE_SIZE;
+        int y0 = (tile / tilesX) * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, width);
+        int y1 = std::min(y0 + TILE_SIZE, height);
+        int count = x1 - x0;
+        uint32_t row[TILE_SIZE];
+
+        //  pixels of the scaled source the samples show, -1 where outside
+        int samples[2][TILE_SIZE * TILE_SIZE];
+        int minX = INT_MAX;
+        int minY = INT_MAX;
+        int maxX = INT_MIN;
+        int maxY = INT_MIN;
+        bool outside = _tileOutsideQuad(quad, x0, y0, x1, y1);
+        for (int y = y0; y < y1 && !outside; y++)
+        {
+            const float* xs = coordinates.getXs(y) + x0;
+            const float* ys = coordinates.getYs(y) + x0;
+            for (int i = 0; i < count; i++)
+            {
+                float x = xs[i] * toScaled;
+                float v = ys[i] * toScaled;
+                int k = (y - y0) * TILE_SIZE + i;
+                if (!(x >= 0 && v >= 0 && x < scaledWidth && v < scaledHeight))
+                {
+                    samples[0][k] = -1;
+                    continue;
+                }
+                int sx = std::min((static_cast<int>(x * 256.0f) + 128) >> 8, ROTSPRITE_FACTOR * srcWidth - 1);
+                int sy = std::min((static_cast<int>(v * 256.0f) + 128) >> 8, ROTSPRITE_FACTOR * srcHeight - 1);
+                samples[0][k] = sx;
+                samples[1][k] = sy;
+                minX = std::min(minX, sx);
+                maxX = std::max(maxX, sx);
+                minY = std::min(minY, sy);
+                maxY = std::max(maxY, sy);
+            }
+        }
+        if (minX > maxX)
+        {
+            std::fill(row, row + count, BLANK_PIXEL);
+            for (int y = y0; y < y1; y++)
+                storeRow(result, x0, y, row, count);
+            return;
+        }
+
+        //  first pass pixels under the second pass pixels of the samples and their neighbours,
+        //  with one more around for the neighbours of those
+        int left = std::max(0, ((minX >> 1) - 1) >> 1) - 1;
+        int top = std::max(0, ((minY >> 1) - 1) >> 1) - 1;
+        int right = std::min(2 * srcWidth - 1, ((maxX >> 1) + 1) >> 1) + 1;
+        int bottom = std::min(2 * srcHeight - 1, ((maxY >> 1) + 1) >> 1) + 1;
+        int cacheStride = right - left + 1;
+        std::vector<uint32_t> cache(cacheStride * (bottom - top + 1));
+        for (int y = top; y <= bottom; y++)
+        {
+            int cy = std::max(0, std::min(y, 2 * srcHeight - 1));
+            uint32_t* out = &cache[(y - top) * cacheStride];
+            for (int x = left; x <= right; x++)
+            {
+                int cx = std::max(0, std::min(x, 2 * srcWidth - 1));
+                const uint32_t* e = addressing(cx >> 1, cy >> 1);
+                *out++ = _scale2xCorner(e[0], e[-stride], e[-1], e[1], e[stride], (cx & 1) | ((cy & 1) << 1));
+            }
+        }
+        auto second = [&](int x, int y) -> uint32_t
+        {
+            const uint32_t* e = &cache[((y >> 1) - top) * cacheStride + (x >> 1) - left];
+            return _scale2xCorner(e[0], e[-cacheStride], e[-1], e[1], e[cacheStride], (x & 1) | ((y & 1) << 1));
+        };
+
+        for (int y = y0; y < y1; y++)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                int k = (y - y0) * TILE_SIZE + i;
+                if (samples[0][k] < 0)
+                {
+                    row[i] = BLANK_PIXEL;
+                    continue;
+                }
+                int sx = samples[0][k];
+                int sy = samples[1][k];
+                int x2 = sx >> 1;
+                int y2 = sy >> 1;
+                row[i] = _scale2xCorner(second(x2, y2), second(x2, std::max(y2 - 1, 0)), second(std::max(x2 - 1, 0), y2),
+                                        second(std::min(x2 + 1, lastX2), y2), second(x2, std::min(y2 + 1, lastY2)),
+                                        (sx & 1) | ((sy & 1) << 1));
+            }
+            storeRow(result, x0, y, row, count);
+        }
+    });
+}
+
+Surface pp::transformRotSprite(Surface& source, TransformMapping& targetMapping, TransformMethod method)
+{
+    //  without a transform the whole scaled source, each pixel mapped onto itself
+    Area scaledBounds(0, 0, ROTSPRITE_FACTOR * source.getWidth(), ROTSPRITE_FACTOR * source.getHeight());
+    if (method == TM_IDENTITY)
+    {
+        TransformMapping scaledMapping(scaledBounds);
+        return transformRotSprite(source, scaledMapping, TM_PROJECTIVE);
+    }
+    CoordinateMap coordinates(scaledBounds, targetMapping, method);
+    Surface result(coordinates.getWidth(), coordinates.getHeight(), source.hasAlpha());
+    _drawRotSprite(source, coordinates, 1.0f, result);
+    return result;
+}
+
+Surface pp::transformRotSprite(Surface& source, const CoordinateMap& coordinates)
+{
+    if (coordinates.getMethod() == TM_IDENTITY)
+    {
+        TransformMapping sourceMapping(source.getBounds());
+        return transformRotSprite(source, sourceMapping, TM_IDENTITY);
+    }
+    Surface result(coordinates.getWidth(), coordinates.getHeight(), source.hasAlpha());
+    _drawRotSprite(source, coordinates, (float)ROTSPRITE_FACTOR, result);
+    return result;
+}
+
+//  the sampler behind each SamplingMethod and how it is built
+template<int Method> struct _SamplerOf;
+
+template<> struct _SamplerOf<SAMPLE_NEAREST>
+{
+    typedef NearestNeighbourSampler Type;
+    static Type make(Surface& source, const SamplingOptions& sampling) { return Type(source, sampling.border); }
+};
+
+template<> struct _SamplerOf<SAMPLE_BILINEAR>
+{
+    typedef BilinearSampler Type;
+    static Type make(Surface& source, const SamplingOptions& sampling) { return Type(source, sampling.border); }
+};
+
+template<> struct _SamplerOf<SAMPLE_BICUBIC>
+{
+    typedef BicubicSampler Type;
+    static Type make(Surface& source, const SamplingOptions& sampling) { return Type(source, sampling.border); }
+};
 
-            vSrc /= vSrc.z;
-            if (vSrc.x >= 0 && vSrc.y >= 0 && vSrc.x < srcWidth && vSrc.y < srcHeight)
-                dest.setPixel(ivec2(x, y), sampler(vSrc.x, vSrc.y));
-            else
-                dest.setPixel(ivec2(x, y), blank);
-        }
-}
+template<> struct _SamplerOf<SAMPLE_AREA>
+{
+    typedef AreaSampler Type;
+    static Type make(Surface& source, const SamplingOptions&) { return Type(source); }
+};
 
-vec2 _transformInvBilinear(vec2 p, vec2* q)
+template<int Order> struct _DominanceOf
 {
-    //  non-inverse is easy:
-    //  p = (1-u)*(1-v)*q[0] + (1-u)*v*q[3] + u*(1-v)*q[1] + u*v*q[2]
-    //  solve p.x and p.y to v and get
-    //  v = ( (1-u)*(x0-x) + u*(x1-x) ) / ( (1-u)*(x0-x3) + u*(x1-x2) )
-    //  v = ( (1-u)*(y0-y) + u*(y1-y) ) / ( (1-u)*(y0-y3) + u*(y1-y2) )
+    typedef BilinearDominanceSampler Type;
+    static Type make(Surface& source, const SamplingOptions&) { return Type(source, Order); }
+};
+template<> struct _SamplerOf<SAMPLE_FIRST_BILINEAR> : _DominanceOf<0> {};
+template<> struct _SamplerOf<SAMPLE_SECOND_BILINEAR> : _DominanceOf<1> {};
 
-    //  A*(1-u)^2 + B*2u(1-u) + C*u^2 = 0
+template<> struct _SamplerOf<SAMPLE_BEST_FIT_NARROW>
+{
+    typedef BicubicBestFitSampler Type;
+    static Type make(Surface& source, const SamplingOptions&) { return Type(source, false); }
+};
 
-    double A = cross(vec3(q[0]-p, 0), vec3(q[0]-q[3], 0)).z;
-    double B = (cross(vec3(q[0]-p, 0), vec3(q[1]-q[2], 0)).z + cross(vec3(q[1]-p, 0), vec3(q[0]-q[3], 0)).z) / 2;
-    double C = cross(vec3(q[1]-p, 0), vec3(q[1]-q[2], 0)).z;
+template<> struct _SamplerOf<SAMPLE_BEST_FIT_WIDE>
+{
+    typedef BicubicBestFitSampler Type;
+    static Type make(Surface& source, const SamplingOptions&) { return Type(source, true); }
+};
 
-    //  FIND U
-    double u = 0;
-    double div = (A - 2*B + C);
-    if (std::abs(div) < ci::EPSILON_VALUE)
-        u = ((A-C) != 0) ? A / (A-C) : 0;  //  U
-    else
+template<> struct _SamplerOf<SAMPLE_BEST_FIT_ANY>
+{
+    typedef BicubicBestFitSampler Type;
+    static Type make(Surface& source, const SamplingOptions& sampling)
     {
-        u = ((A-B) + sqrt(B*B - A*C)) / div;
-        if (u < 0 || u > 1)
-            u = ((A-B) - sqrt(B*B - A*C)) / div;
+        if (sampling.palette)
+            return Type(source, *sampling.palette);
+        Palette colors;
+        getColors(source, colors);
+        return Type(source, colors);
     }
+};
 
-    //  FIND V
-    double v = 0;
-    vec2 vDiv = (float)(1-u) * (vec2(q[0]-q[3])) + (float)u*(vec2(q[1]-q[2]));
-    if (fabs(vDiv.x) > fabs(vDiv.y))
-        v = ( (1-u)*(q[0].x-p.x) + u*(q[1].x-p.x) ) / vDiv.x;
-    else if (vDiv.y != 0)
-        v = ( (1-u)*(q[0].y-p.y) + u*(q[1].y-p.y) ) / vDiv.y;
+template<int Order> struct _WeightOf
+{
+    typedef WeightSampler Type;
+    static Type make(Surface& source, const SamplingOptions&) { return Type(source, Order); }
+};
+template<> struct _SamplerOf<SAMPLE_FIRST_WEIGHT> : _WeightOf<0> {};
+template<> struct _SamplerOf<SAMPLE_SECOND_WEIGHT> : _WeightOf<1> {};
 
-    return vec2(u, v);
+template<int Method>
+Surface _transformAs(Surface& source, const CoordinateMap& coordinates, const TransformOptions& options, const SamplingOptions& sampling)
+{
+    typename _SamplerOf<Method>::Type sampler = _SamplerOf<Method>::make(source, sampling);
+    return transform(sampler, coordinates, options);
 }
 
-template<class Sampler>
-void _drawBilinear(Sampler& sampler, TransformMapping& srcMapping, Surface& dest, TransformMapping& destMapping)
+template<>
+Surface _transformAs<SAMPLE_MINIMIZE_ERROR>(Surface& source, const CoordinateMap& coordinates, const TransformOptions&, const SamplingOptions& sampling)
 {
-    mat3 uvToSource = _mapUnitSquareToQuad(srcMapping.localQuad);
-
-    //  for each target pixel find one in source!
-    float srcWidth = sampler.source.getWidth();
-    float srcHeight = sampler.source.getHeight();
-    Color8u blank = Color8u();
-    for (int x = 0; x < dest.getWidth(); x++)
-        for (int y = 0; y < dest.getHeight(); y++)
-        {
-            float u = (x+0.5) / (float)dest.getWidth();
-            float v = (y+0.5) / (float)dest.getHeight();
-            vec2 uv = _transformInvBilinear(vec2(x,y), destMapping.localQuad);
-            if (u >= 0 && u <= 1 && v >= 0 && v <= 1)
-            {
-                vec3 vSrc = uvToSource* vec3(uv.x, uv.y, 1);
-                vSrc /= vSrc.z;
-                if (vSrc.x >= 0 && vSrc.y >= 0 && vSrc.x < srcWidth && vSrc.y < srcHeight)
-                    dest.setPixel(ivec2(x, y), sampler(vSrc.x, vSrc.y));
-                else
-                    dest.setPixel(ivec2(x, y), blank);
-            };
-        }
+    return transformMix(source, coordinates, sampling.mixThreshold);
 }
 
-template<class Sampler>
-Surface pp::transform(Sampler& sampler, TransformMapping& targetMapping, TransformMethod method)
+template<>
+Surface _transformAs<SAMPLE_ROTSPRITE>(Surface& source, const CoordinateMap& coordinates, const TransformOptions&, const SamplingOptions&)
 {
-    if (method == TM_IDENTITY)
-        return sampler.source;
+    return transformRotSprite(source, coordinates);
+}
 
-    Surface result(targetMapping.bounds.getWidth(), targetMapping.bounds.getHeight(), sampler.source.hasAlpha());
-    TransformMapping srcMapping(sampler.source.getBounds());
-    switch (method)
-    {
-    case TM_PROJECTIVE:
-        _drawProjective(sampler, srcMapping, result, targetMapping);
-        break;
-    case TM_BILINEAR:
-        _drawBilinear(sampler, srcMapping, result, targetMapping);
-        break;
-    default:
-        break;
-    }
-    return result;
+//  one instantiation per SamplingMethod, in the order of the enum
+typedef Surface (*_TransformAs)(Surface&, const CoordinateMap&, const TransformOptions&, const SamplingOptions&);
+const _TransformAs TRANSFORM_AS[] = {
+    &_transformAs<SAMPLE_NEAREST>,
+    &_transformAs<SAMPLE_BILINEAR>,
+    &_transformAs<SAMPLE_BICUBIC>,
+    &_transformAs<SAMPLE_AREA>,
+    &_transformAs<SAMPLE_FIRST_BILINEAR>,
+    &_transformAs<SAMPLE_SECOND_BILINEAR>,
+    &_transformAs<SAMPLE_BEST_FIT_NARROW>,
+    &_transformAs<SAMPLE_BEST_FIT_WIDE>,
+    &_transformAs<SAMPLE_BEST_FIT_ANY>,
+    &_transformAs<SAMPLE_FIRST_WEIGHT>,
+    &_transformAs<SAMPLE_SECOND_WEIGHT>,
+    &_transformAs<SAMPLE_MINIMIZE_ERROR>,
+    &_transformAs<SAMPLE_ROTSPRITE>
+};
+static_assert(sizeof(TRANSFORM_AS) / sizeof(TRANSFORM_AS[0]) == SAMPLE_ROTSPRITE + 1, "a SamplingMethod is missing from TRANSFORM_AS");
+
+Surface pp::transform(Surface& source, SamplingMethod method, const CoordinateMap& coordinates, const TransformOptions& options,
+                      const SamplingOptions& sampling)
+{
+    assert(method >= 0 && method <= SAMPLE_ROTSPRITE);
+    return TRANSFORM_AS[method](source, coordinates, options, sampling);
 }
 
 // ****** SAMPLER ******
 
+//  sources wider than this are tiled, so that rotated walks over them stay within a few cache lines
+const int TILED_SOURCE_WIDTH = 512;
+
+PixelBuffer::Layout _sourceLayout(const Surface& source)
+{
+    return (source.getWidth() > TILED_SOURCE_WIDTH) ? PixelBuffer::TILED : PixelBuffer::ROW_MAJOR;
+}
+
 //  NEAREST NEIGHBOUR
-template Surface pp::transform<NearestNeighbourSampler>(NearestNeighbourSampler& source, TransformMapping& targetMapping, TransformMethod method);
+template Surface pp::transform<NearestNeighbourSampler>(NearestNeighbourSampler& source, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template Surface pp::transform<NearestNeighbourSampler>(NearestNeighbourSampler& source, const CoordinateMap& coordinates, const TransformOptions& options);
+template Surface pp::transformScaled<NearestNeighbourSampler>(NearestNeighbourSampler& source, ScaleMethod scaleMethod, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template std::vector<Surface> pp::transformFrames<NearestNeighbourSampler>(NearestNeighbourSampler& source, ScaleMethod scaleMethod, std::vector<TransformMapping>& targetMappings, TransformMethod method, const TransformOptions& options);
 
-NearestNeighbourSampler::NearestNeighbourSampler(Surface& src)
+NearestNeighbourSampler::NearestNeighbourSampler(Surface& src, PixelBuffer::Border border)
 {
     source = src;
+    //  rounding up at the last column/row reads one pixel past the edge
+    pixels = PixelBuffer(src, 1, _sourceLayout(src), border);
 }
 
 ColorA8u NearestNeighbourSampler::operator()(float x, float y)
@@ -217,12 +2245,88 @@ ColorA8u NearestNeighbourSampler::operator()(float x, float y)
     return source.getPixel(srcPxl);
 }
 
+#if defined(PP_AVX2)
+static const bool CPU_HAS_AVX2 = pp::hasAvx2();
+
+//  NearestNeighbourSampler::sampleRow() eight lanes at a time with a masked gather,
+//  returns how many of the count samples it wrote
+PP_TARGET_AVX2 static int _sampleRowNearestAvx2(const PixelAddressing& addressing, float srcWidth, float srcHeight,
+                                                const float* xs, const float* ys, int count, uint32_t* out)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 width = _mm256_set1_ps(srcWidth);
+    const __m256 height = _mm256_set1_ps(srcHeight);
+    const __m256 fixedOne = _mm256_set1_ps(256.0f);
+    const __m256i half = _mm256_set1_epi32(128);
+    const __m128i tileShift = _mm_cvtsi32_si128(addressing.shift);
+    const __m256i lastTileX = _mm256_set1_epi32(addressing.lastTileX);
+    const __m256i lastTileY = _mm256_set1_epi32(addressing.lastTileY);
+    const __m256i tilesX = _mm256_set1_epi32(addressing.lastTileX + 1);
+    const __m256i tileSize = _mm256_set1_epi32(addressing.tileSize);
+    const __m256i rowInc = _mm256_set1_epi32(addressing.stride);
+    const __m256i corner = _mm256_set1_epi32(addressing.corner);
+    const __m256i blank = _mm256_set1_epi32(BLANK_PIXEL);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_GE_OQ), _mm256_cmp_ps(y, zero, _CMP_GE_OQ)),
+                                      _mm256_and_ps(_mm256_cmp_ps(x, width, _CMP_LT_OQ), _mm256_cmp_ps(y, height, _CMP_LT_OQ)));
+        __m256i ix = _mm256_srai_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(x, fixedOne)), half), 8);
+        __m256i iy = _mm256_srai_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(y, fixedOne)), half), 8);
+        //  PixelAddressing::offset() on all lanes
+        __m256i tx = _mm256_min_epi32(_mm256_srl_epi32(_mm256_max_epi32(ix, _mm256_setzero_si256()), tileShift), lastTileX);
+        __m256i ty = _mm256_min_epi32(_mm256_srl_epi32(_mm256_max_epi32(iy, _mm256_setzero_si256()), tileShift), lastTileY);
+        __m256i inner = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(iy, _mm256_sll_epi32(ty, tileShift)), rowInc),
+                                         _mm256_sub_epi32(ix, _mm256_sll_epi32(tx, tileShift)));
+        __m256i tile = _mm256_add_epi32(_mm256_mullo_epi32(ty, tilesX), tx);
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(tile, tileSize), _mm256_add_epi32(inner, corner));
+        //  lanes outside the source are not fetched and keep the blank value
+        __m256i result = _mm256_mask_i32gather_epi32(blank, reinterpret_cast<const int*>(addressing.base), index, _mm256_castps_si256(inside), 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+    }
+    return i;
+}
+#endif
+
+void NearestNeighbourSampler::sampleRow(const float* xs, const float* ys, int count, uint32_t* out)
+{
+    //  coordinates go to 24.8 fixed point so that rounding is an add and a shift,
+    //  (floor(256*x) + 128) >> 8 == floor(x + 0.5) for all x >= 0
+    const PixelAddressing& addressing = pixels.getAddressing();
+    float srcWidth = pixels.getWidth();
+    float srcHeight = pixels.getHeight();
+    int i = 0;
+#if defined(PP_AVX2)
+    if (CPU_HAS_AVX2)
+        i = _sampleRowNearestAvx2(addressing, srcWidth, srcHeight, xs, ys, count, out);
+#endif
+    for (; i < count; i++)
+    {
+        float x = xs[i];
+        float y = ys[i];
+        if (x >= 0 && y >= 0 && x < srcWidth && y < srcHeight)
+        {
+            int ix = (static_cast<int>(x * 256.0f) + 128) >> 8;
+            int iy = (static_cast<int>(y * 256.0f) + 128) >> 8;
+            out[i] = *addressing(ix, iy);
+        }
+        else
+            out[i] = BLANK_PIXEL;
+    }
+}
+
 //  BILINEAR
-template Surface pp::transform<BilinearSampler>(BilinearSampler& source, TransformMapping& targetMapping, TransformMethod method);
+template Surface pp::transform<BilinearSampler>(BilinearSampler& source, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template Surface pp::transform<BilinearSampler>(BilinearSampler& source, const CoordinateMap& coordinates, const TransformOptions& options);
+template Surface pp::transformScaled<BilinearSampler>(BilinearSampler& source, ScaleMethod scaleMethod, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template std::vector<Surface> pp::transformFrames<BilinearSampler>(BilinearSampler& source, ScaleMethod scaleMethod, std::vector<TransformMapping>& targetMappings, TransformMethod method, const TransformOptions& options);
 
-BilinearSampler::BilinearSampler(cinder::Surface& src)
+BilinearSampler::BilinearSampler(cinder::Surface& src, PixelBuffer::Border border)
 {
     source = src;
+    pixels = PixelBuffer(src, 1, _sourceLayout(src), border);
 }
 
 ColorA8u BilinearSampler::operator()(float x, float y)
@@ -247,7 +2351,99 @@ ColorA8u BilinearSampler::operator()(float x, float y)
          + d*(subx     * suby);
 }
 
-template Surface pp::transform<BicubicSampler>(BicubicSampler& source, TransformMapping& targetMapping, TransformMethod method);
+//  Both lerps run on 8 bit weights, the horizontal one keeps 15 bits of its result
+//  so the vertical one still fits a signed 16 bit multiply-add. Truncating like the
+//  float path did keeps us within 1 of it and exact on flat areas.
+inline uint32_t _bilinearPixel(const uint32_t* p, int stride, int fx, int fy)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        int top = ((0xFF & (p[0] >> shift)) * (256 - fx) + (0xFF & (p[1] >> shift)) * fx) >> 1;
+        int bottom = ((0xFF & (p[stride] >> shift)) * (256 - fx) + (0xFF & (p[stride+1] >> shift)) * fx) >> 1;
+        result |= uint32_t((top * (256 - fy) + bottom * fy) >> 15) << shift;
+    }
+    return result;
+}
+
+#if defined(PP_SSE2)
+//  a and b hold two pixels each as 16 bit channels, wa/wb the interleaved weights
+//  (256-f, f) for the first/second pixel; returns the weighted sums as 32 bit lanes
+inline void _madd2(__m128i a, __m128i b, __m128i wa, __m128i wb, __m128i& first, __m128i& second)
+{
+    first = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wa);
+    second = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wb);
+}
+
+inline __m128i _unpackPixels(uint32_t p0, uint32_t p1)
+{
+    return _mm_unpacklo_epi8(_mm_set_epi32(0, 0, p1, p0), _mm_setzero_si128());
+}
+
+inline __m128i _pairWeights(int f)
+{
+    return _mm_set1_epi32((f << 16) | (256 - f));
+}
+#endif
+
+void BilinearSampler::sampleRow(const float* xs, const float* ys, int count, uint32_t* out)
+{
+    //  weights are rounded to 8 bit fixed point (0..256); the left/top corner plus one
+    //  is always read, where the old ceil() would have repeated it its weight is 0
+    const PixelAddressing& addressing = pixels.getAddressing();
+    const uint32_t* base = addressing.base;
+    int stride = addressing.stride;
+    float srcWidth = pixels.getWidth();
+    float srcHeight = pixels.getHeight();
+    const int batch = 4;
+    int offset[batch];
+    int fx[batch];
+    int fy[batch];
+    bool inside[batch];
+    for (int i = 0; i < count; i += batch)
+    {
+        int n = std::min(batch, count - i);
+        for (int k = 0; k < batch; k++)
+        {
+            float x = (k < n) ? xs[i+k] : -1;
+            float y = (k < n) ? ys[i+k] : -1;
+            inside[k] = x >= 0 && y >= 0 && x < srcWidth && y < srcHeight;
+            int fixedX = inside[k] ? static_cast<int>(x * 512.0f) : 0;
+            int fixedY = inside[k] ? static_cast<int>(y * 512.0f) : 0;
+            offset[k] = addressing.offset(fixedX >> 9, fixedY >> 9);
+            fx[k] = ((fixedX & 0x1FF) + 1) >> 1;
+            fy[k] = ((fixedY & 0x1FF) + 1) >> 1;
+        }
+        uint32_t result[batch];
+#if defined(PP_SSE2)
+        for (int k = 0; k < batch; k += 2)
+        {
+            const uint32_t* p0 = base + offset[k];
+            const uint32_t* p1 = base + offset[k+1];
+            __m128i wx0 = _pairWeights(fx[k]);
+            __m128i wx1 = _pairWeights(fx[k+1]);
+            __m128i first, second;
+            _madd2(_unpackPixels(p0[0], p1[0]), _unpackPixels(p0[1], p1[1]), wx0, wx1, first, second);
+            __m128i top = _mm_packs_epi32(_mm_srli_epi32(first, 1), _mm_srli_epi32(second, 1));
+            _madd2(_unpackPixels(p0[stride], p1[stride]), _unpackPixels(p0[stride+1], p1[stride+1]), wx0, wx1, first, second);
+            __m128i bottom = _mm_packs_epi32(_mm_srli_epi32(first, 1), _mm_srli_epi32(second, 1));
+            _madd2(top, bottom, _pairWeights(fy[k]), _pairWeights(fy[k+1]), first, second);
+            __m128i mixed = _mm_packs_epi32(_mm_srli_epi32(first, 15), _mm_srli_epi32(second, 15));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(result + k), _mm_packus_epi16(mixed, mixed));
+        }
+#else
+        for (int k = 0; k < batch; k++)
+            result[k] = _bilinearPixel(base + offset[k], stride, fx[k], fy[k]);
+#endif
+        for (int k = 0; k < n; k++)
+            out[i+k] = inside[k] ? result[k] : BLANK_PIXEL;
+    }
+}
+
+template Surface pp::transform<BicubicSampler>(BicubicSampler& source, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template Surface pp::transform<BicubicSampler>(BicubicSampler& source, const CoordinateMap& coordinates, const TransformOptions& options);
+template Surface pp::transformScaled<BicubicSampler>(BicubicSampler& source, ScaleMethod scaleMethod, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template std::vector<Surface> pp::transformFrames<BicubicSampler>(BicubicSampler& source, ScaleMethod scaleMethod, std::vector<TransformMapping>& targetMappings, TransformMethod method, const TransformOptions& options);
 
 double _cubicInterpolate(double p[4], double x)
 {
@@ -264,9 +2460,150 @@ double _bicubicInterpolate(double p[4][4], double x, double y)
     return constrain(_cubicInterpolate(arr, x), 0.0, 1.0);
 }
 
-BicubicSampler::BicubicSampler(cinder::Surface& src)
+//  Finds the 4x4 footprint of (x, y): offset of its top left pixel and the rounded phases.
+inline bool _bicubicFootprint(const PixelBuffer& pixels, float x, float y, int& offset, int& phaseX, int& phaseY)
+{
+    if (!(x >= 0 && y >= 0 && x < pixels.getWidth() && y < pixels.getHeight()))
+        return false;
+    int fixedX = static_cast<int>(x * 512.0f);
+    int fixedY = static_cast<int>(y * 512.0f);
+    offset = pixels.getAddressing().offset(fixedX >> 9, fixedY >> 9) - pixels.getStride() - 1;  // from the base
+    phaseX = ((fixedX & 0x1FF) + 1) >> 1;
+    phaseY = ((fixedY & 0x1FF) + 1) >> 1;
+    return true;
+}
+
+//  Separable bicubic of all four channels at once, each row is weighted horizontally
+//  and the four row results vertically. Channels are in packed order (b, g, r, a)
+//  and scaled 0..255, clamped but not rounded.
+#if defined(PP_SSE2)
+inline __m128 _bicubicChannels(const uint32_t* p, int stride, const float* wx, const float* wy)
+{
+    __m128 sum = _mm_setzero_ps();
+    for (int j = 0; j < 4; j++, p += stride)
+    {
+        __m128 row = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_loadChannels(p[0]), _mm_set1_ps(wx[0])),
+                                           _mm_mul_ps(_loadChannels(p[1]), _mm_set1_ps(wx[1]))),
+                                _mm_add_ps(_mm_mul_ps(_loadChannels(p[2]), _mm_set1_ps(wx[2])),
+                                           _mm_mul_ps(_loadChannels(p[3]), _mm_set1_ps(wx[3]))));
+        sum = _mm_add_ps(sum, _mm_mul_ps(row, _mm_set1_ps(wy[j])));
+    }
+    return _mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+}
+
+inline void _bicubicChannels(const uint32_t* p, int stride, const float* wx, const float* wy, float* channels)
+{
+    _mm_storeu_ps(channels, _bicubicChannels(p, stride, wx, wy));
+}
+#else
+inline void _bicubicChannels(const uint32_t* p, int stride, const float* wx, const float* wy, float* channels)
+{
+    for (int c = 0; c < 4; c++)
+    {
+        int shift = 8 * c;
+        float sum = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            const uint32_t* row = p + j * stride;
+            float value = wx[0] * (0xFF & (row[0] >> shift)) + wx[1] * (0xFF & (row[1] >> shift))
+                        + wx[2] * (0xFF & (row[2] >> shift)) + wx[3] * (0xFF & (row[3] >> shift));
+            sum += wy[j] * value;
+        }
+        channels[c] = constrain(sum, 0.0f, 255.0f);
+    }
+}
+#endif
+
+BicubicSampler::BicubicSampler(cinder::Surface& src, PixelBuffer::Border border)
 {
     source = src;
+    //  the footprint reaches one pixel left/up and two right/down
+    pixels = PixelBuffer(src, 2, _sourceLayout(src), border);
+}
+
+void BicubicSampler::sampleRow(const float* xs, const float* ys, int count, uint32_t* out)
+{
+    const uint32_t* base = pixels.getAddressing().base;
+    int stride = pixels.getStride();
+    for (int i = 0; i < count; i++)
+    {
+        int offset, phaseX, phaseY;
+        if (!_bicubicFootprint(pixels, xs[i], ys[i], offset, phaseX, phaseY))
+        {
+            out[i] = BLANK_PIXEL;
+            continue;
+        }
+        const float* wx = CATMULL_ROM.weights[phaseX];
+        const float* wy = CATMULL_ROM.weights[phaseY];
+#if defined(PP_SSE2)
+        out[i] = _packChannels(_bicubicChannels(base + offset, stride, wx, wy));
+#else
+        float c[4];
+        _bicubicChannels(base + offset, stride, wx, wy, c);
+        out[i] = (uint32_t(c[3]) << 24) | (uint32_t(c[2]) << 16) | (uint32_t(c[1]) << 8) | uint32_t(c[0]);
+#endif
+    }
+}
+
+//  Bicubic with FIXED_CATMULL_ROM. Each row is summed in 14 fraction bits and rounded to 6,
+//  which keeps it within 16 bits, the rows in 20; the channels are rounded down and clamped
+//  like the float sampler does. SSE2 and the scalar code do the same integer steps.
+void _sampleRowFixed(BicubicSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    const PixelBuffer& pixels = sampler.pixels;
+    const uint32_t* base = pixels.getAddressing().base;
+    int stride = pixels.getStride();
+    for (int i = 0; i < count; i++)
+    {
+        int offset, phaseX, phaseY;
+        if (!_bicubicFootprint(pixels, xs[i], ys[i], offset, phaseX, phaseY))
+        {
+            out[i] = BLANK_PIXEL;
+            continue;
+        }
+        const uint32_t* p = base + offset;
+#if defined(PP_SSE2)
+        __m128i zero = _mm_setzero_si128();
+        __m128i wx01 = _mm_set1_epi32(FIXED_CATMULL_ROM.pairs[phaseX][0]);
+        __m128i wx23 = _mm_set1_epi32(FIXED_CATMULL_ROM.pairs[phaseX][1]);
+        __m128i round = _mm_set1_epi32(128);
+        __m128i rows[4];
+        for (int j = 0; j < 4; j++, p += stride)
+        {
+            __m128i pxl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i left = _mm_unpacklo_epi8(pxl, zero);    // pixels 0, 1
+            __m128i right = _mm_unpackhi_epi8(pxl, zero);   // pixels 2, 3
+            //  channel by channel pairs of pixel 0, 1 and 2, 3
+            __m128i sum = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(left, _mm_srli_si128(left, 8)), wx01),
+                                        _mm_madd_epi16(_mm_unpacklo_epi16(right, _mm_srli_si128(right, 8)), wx23));
+            rows[j] = _mm_srai_epi32(_mm_add_epi32(sum, round), 8);
+        }
+        __m128i top = _mm_packs_epi32(rows[0], rows[1]);
+        __m128i bottom = _mm_packs_epi32(rows[2], rows[3]);
+        __m128i sum = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(top, _mm_srli_si128(top, 8)), _mm_set1_epi32(FIXED_CATMULL_ROM.pairs[phaseY][0])),
+                                    _mm_madd_epi16(_mm_unpacklo_epi16(bottom, _mm_srli_si128(bottom, 8)), _mm_set1_epi32(FIXED_CATMULL_ROM.pairs[phaseY][1])));
+        __m128i c = _mm_srai_epi32(sum, 20);
+        c = _mm_packs_epi32(c, c);
+        out[i] = _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+#else
+        const int* wx = FIXED_CATMULL_ROM.weights[phaseX];
+        const int* wy = FIXED_CATMULL_ROM.weights[phaseY];
+        uint32_t pixel = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            int sum = 0;
+            for (int j = 0; j < 4; j++)
+            {
+                const uint32_t* row = p + j * stride;
+                int value = wx[0] * int(0xFF & (row[0] >> shift)) + wx[1] * int(0xFF & (row[1] >> shift))
+                          + wx[2] * int(0xFF & (row[2] >> shift)) + wx[3] * int(0xFF & (row[3] >> shift));
+                sum += wy[j] * ((value + 128) >> 8);
+            }
+            pixel |= uint32_t(constrain(sum >> 20, 0, 255)) << shift;
+        }
+        out[i] = pixel;
+#endif
+    }
 }
 
 ci::ColorA8u BicubicSampler::operator()(float x, float y)
@@ -295,14 +2632,204 @@ ci::ColorA8u BicubicSampler::operator()(float x, float y)
     return result;
 }
 
-template Surface pp::transform<BilinearDominanceSampler>(BilinearDominanceSampler& source, TransformMapping& targetMapping, TransformMethod method);
+//  AREA
+template Surface pp::transform<AreaSampler>(AreaSampler& source, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template Surface pp::transform<AreaSampler>(AreaSampler& source, const CoordinateMap& coordinates, const TransformOptions& options);
+template Surface pp::transformScaled<AreaSampler>(AreaSampler& source, ScaleMethod scaleMethod, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template std::vector<Surface> pp::transformFrames<AreaSampler>(AreaSampler& source, ScaleMethod scaleMethod, std::vector<TransformMapping>& targetMappings, TransformMethod method, const TransformOptions& options);
+
+AreaSampler::AreaSampler(cinder::Surface& src)
+{
+    source = src;
+    pixels = PixelBuffer(src, 1);
+    mips = std::make_shared<MipPyramid>(pixels);
+}
+
+//  bilinear sample of mip level k at level 0 coordinates (x, y)
+inline uint32_t _levelPixel(const PixelBuffer& level, int k, float x, float y)
+{
+    float scale = 1.0f / (1 << k);
+    float offset = 0.5f * ((1 << k) - 1);
+    float u = constrain((x - offset) * scale, 0.0f, level.getWidth() - 1.0f);
+    float v = constrain((y - offset) * scale, 0.0f, level.getHeight() - 1.0f);
+    int fixedX = static_cast<int>(u * 512.0f);
+    int fixedY = static_cast<int>(v * 512.0f);
+    int stride = level.getStride();
+    const uint32_t* p = level.getOrigin() + (fixedY >> 9) * stride + (fixedX >> 9);
+    return _bilinearPixel(p, stride, ((fixedX & 0x1FF) + 1) >> 1, ((fixedY & 0x1FF) + 1) >> 1);
+}
+
+ColorA8u AreaSampler::operator()(float x, float y)
+{
+    //  a single point has no footprint
+    return unpackPixel(_levelPixel(pixels, 0, x, y));
+}
+
+void AreaSampler::sampleRow(const float* xs, const float* ys, int count, uint32_t* out)
+{
+    sampleRow(xs, ys, NULL, NULL, count, out);
+}
+
+void AreaSampler::sampleRow(const float* xs, const float* ys, const float* nextXs, const float* nextYs, int count, uint32_t* out)
+{
+    float srcWidth = pixels.getWidth();
+    float srcHeight = pixels.getHeight();
+    for (int i = 0; i < count; i++)
+    {
+        float x = xs[i];
+        float y = ys[i];
+        if (!(x >= 0 && y >= 0 && x < srcWidth && y < srcHeight))
+        {
+            out[i] = BLANK_PIXEL;
+            continue;
+        }
+
+        //  the footprint is spanned by the steps to the next sample in the row and the
+        //  next row; without the next row assume the same step turned by 90 degrees
+        int j = (nextXs || i + 1 < count) ? i + 1 : std::max(i - 1, 0);
+        float dxx = xs[j] - x;
+        float dxy = ys[j] - y;
+        float dyx = nextXs ? nextXs[i] - x : -dxy;
+        float dyy = nextYs ? nextYs[i] - y : dxx;
+        float rho2 = std::max(dxx*dxx + dxy*dxy, dyx*dyx + dyy*dyy);
+        int last = mips->getLevelCount() - 1;
+        float lod = (rho2 > 1) ? std::min(0.5f * (float)log2(rho2), (float)last) : 0;
+
+        int k = (int)lod;
+        int t = static_cast<int>((lod - k) * 256.0f + 0.5f);
+        uint32_t result = _levelPixel(mips->getLevel(k), k, x, y);
+        if (t > 0 && k < last)
+            result = _lerpPixel(result, _levelPixel(mips->getLevel(k + 1), k + 1, x, y), t);
+        out[i] = result;
+    }
+}
+
+inline bool _sameColor(uint32_t a, uint32_t b)
+{
+    return ((a ^ b) & 0x00FFFFFF) == 0;
+}
+
+//  indices of an IndexedPixels are equal exactly when the rgb of their colors is
+inline bool _sameColor(uint8_t a, uint8_t b)
+{
+    return a == b;
+}
+
+//  Votes on the 2x2 footprint of (x, y) in base, packed pixels or color indices at the offsets
+//  of addressing: corners of equal color pool their bilinear weights and the two heaviest
+//  colors win. Ties and the pooled weight of corner d resolve exactly like the per order loops
+//  in operator() below.
+template<class Key>
+inline void _vote(const Key* base, const PixelAddressing& addressing, float x, float y, Key winners[2], DominanceSample& result)
+{
+    int x1 = static_cast<int>(x);
+    int y1 = static_cast<int>(y);
+    float subx = x - x1;
+    float suby = y - y1;
+    //  like ceil(), the right/lower corners repeat the left/upper ones on whole coordinates
+    const Key* p = base + addressing.offset(x1, y1);
+    int right = (subx > 0) ? 1 : 0;
+    int down = (suby > 0) ? addressing.stride : 0;
+    Key corners[4] = { p[0], p[right], p[down], p[down + right] };
+    float cornerWeights[4] = { (1-subx) * (1-suby), subx * (1-suby), (1-subx) * suby, subx * suby };
+    float pooledWeights[4] = { cornerWeights[0], cornerWeights[1], cornerWeights[2], (1-subx) * suby };
+
+    Key colors[4];
+    float weights[4];
+    int count = 0;
+    for (int c = 0; c < 4; c++)
+    {
+        int k = 0;
+        while (k < count && !_sameColor(colors[k], corners[c]))
+            k++;
+        if (k < count)
+            weights[k] += pooledWeights[c];
+        else
+        {
+            colors[count] = corners[c];
+            weights[count] = cornerWeights[c];
+            count++;
+        }
+    }
+
+    if (count == 1)
+    {
+        winners[0] = winners[1] = colors[0];
+        result.firstWeight = 255;
+        result.secondWeight = 0;
+        return;
+    }
+    int max = 0;
+    for (int k = 1; k < count; k++)
+        if (weights[k] > weights[max])
+            max = k;
+    winners[0] = colors[max];
+    result.firstWeight = static_cast<uint32_t>(weights[max] * 255);
+    //  move the first entry into the winner's slot and rank the rest
+    weights[max] = weights[0];
+    colors[max] = colors[0];
+    max = 1;
+    for (int k = 2; k < count; k++)
+        if (weights[k] > weights[max])
+            max = k;
+    winners[1] = colors[max];
+    result.secondWeight = static_cast<uint32_t>(weights[max] * 255);
+}
+
+//  the vote on the color indices when the source has them, expanded to packed colors
+inline void _dominance(const PixelBuffer& pixels, const IndexedPixels& indexed, float x, float y, DominanceSample& result)
+{
+    if (indexed.empty())
+    {
+        uint32_t winners[2];
+        _vote(pixels.getAddressing().base, pixels.getAddressing(), x, y, winners, result);
+        result.first = winners[0];
+        result.second = winners[1];
+    }
+    else
+    {
+        uint8_t winners[2];
+        _vote(indexed.getBase(), indexed.getAddressing(), x, y, winners, result);
+        result.first = indexed.getColor(winners[0]);
+        result.second = indexed.getColor(winners[1]);
+    }
+}
+
+inline bool _isInside(const Surface& source, float x, float y)
+{
+    return x >= 0 && y >= 0 && x < source.getWidth() && y < source.getHeight();
+}
+
+template Surface pp::transform<BilinearDominanceSampler>(BilinearDominanceSampler& source, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template Surface pp::transform<BilinearDominanceSampler>(BilinearDominanceSampler& source, const CoordinateMap& coordinates, const TransformOptions& options);
+template Surface pp::transformScaled<BilinearDominanceSampler>(BilinearDominanceSampler& source, ScaleMethod scaleMethod, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template std::vector<Surface> pp::transformFrames<BilinearDominanceSampler>(BilinearDominanceSampler& source, ScaleMethod scaleMethod, std::vector<TransformMapping>& targetMappings, TransformMethod method, const TransformOptions& options);
 
 BilinearDominanceSampler::BilinearDominanceSampler(cinder::Surface& src, int sampleOrder)
 {
     source = src;
+    pixels = PixelBuffer(src, 1, _sourceLayout(src));
+    indexed = IndexedPixels(pixels);
+    if (!indexed.empty())
+        pixels = PixelBuffer();
     order = sampleOrder;
 }
 
+void BilinearDominanceSampler::sampleRow(const float* xs, const float* ys, int count, uint32_t* out)
+{
+    DominanceSample sample;
+    for (int i = 0; i < count; i++)
+    {
+        if (!_isInside(source, xs[i], ys[i]))
+        {
+            out[i] = BLANK_PIXEL;
+            continue;
+        }
+        _dominance(pixels, indexed, xs[i], ys[i], sample);
+        out[i] = (order == 0) ? sample.first : sample.second;
+    }
+}
+
 ColorA8u BilinearDominanceSampler::operator()(float x, float y)
 {
     /*
@@ -402,20 +2929,141 @@ ColorA8u BilinearDominanceSampler::operator()(float x, float y)
     return colors[max];
 }
 
-template Surface pp::transform<BicubicBestFitSampler>(BicubicBestFitSampler& source, TransformMapping& targetMapping, TransformMethod method);
+template Surface pp::transform<BicubicBestFitSampler>(BicubicBestFitSampler& source, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template Surface pp::transform<BicubicBestFitSampler>(BicubicBestFitSampler& source, const CoordinateMap& coordinates, const TransformOptions& options);
+template Surface pp::transformScaled<BicubicBestFitSampler>(BicubicBestFitSampler& source, ScaleMethod scaleMethod, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template std::vector<Surface> pp::transformFrames<BicubicBestFitSampler>(BicubicBestFitSampler& source, ScaleMethod scaleMethod, std::vector<TransformMapping>& targetMappings, TransformMethod method, const TransformOptions& options);
 
-BicubicBestFitSampler::BicubicBestFitSampler(cinder::Surface& src, bool allowOuterPixels) : palette(NULL)
+BicubicBestFitSampler::BicubicBestFitSampler(cinder::Surface& src, bool allowOuterPixels)
 {
     source = src;
+    pixels = PixelBuffer(src, 2, _sourceLayout(src));
     mode = allowOuterPixels ? LOCAL_4x4 : LOCAL_2x2;
 }
 
-BicubicBestFitSampler::BicubicBestFitSampler(cinder::Surface& src, Palette& colors) : palette(&colors)
+BicubicBestFitSampler::BicubicBestFitSampler(cinder::Surface& src, Palette& colors)
+    : palette(std::make_shared<PaletteIndex>(colors))
 {
     source = src;
+    pixels = PixelBuffer(src, 2, _sourceLayout(src));
     mode = PALETTE;
 }
 
+//  the bicubic of operator(), r, g and b scaled 0..1 in double precision, from the footprint p of (x, y)
+inline void _exactBicubic(const uint32_t* p, int stride, float x, float y, float* rgb)
+{
+    double channels[3][4][4];
+    for (int ox = 0; ox < 4; ox++)
+        for (int oy = 0; oy < 4; oy++)
+        {
+            uint32_t pxl = p[oy * stride + ox];
+            channels[0][ox][oy] = (0xFF & (pxl >> 16)) / 255.0f;
+            channels[1][ox][oy] = (0xFF & (pxl >> 8)) / 255.0f;
+            channels[2][ox][oy] = (0xFF & pxl) / 255.0f;
+        }
+    float subx = x - std::floor(x);
+    float suby = y - std::floor(y);
+    for (int c = 0; c < 3; c++)
+        rgb[c] = (float)_bicubicInterpolate(channels[c], subx, suby);
+}
+
+//  The table bicubic rounds the phase by at most 1/512 of a pixel on either axis. The weights'
+//  derivatives sum to 0 and their magnitudes to at most 3, the rows of a footprint span at most
+//  1.25 * 255 and the weights' magnitudes sum to at most 1.25, so each channel is within
+//  2 * 3 * 1.25 * 255 / 2 / 512 < 1.87 of the exact one. BEST_FIT_SLACK bounds the distance
+//  between the two colors, 0..255 scaled, with room for the float sums.
+const float BEST_FIT_SLACK = 3.5f;
+
+//  BicubicBestFitSampler::sampleRow for one mode, the candidates fixed at compile time. The
+//  candidates are ranked by the table bicubic; a choice that the difference to the exact one
+//  could turn, and any palette lookup, is made on the exact color so it matches operator().
+template<int Mode>
+void _bestFitRow(BicubicBestFitSampler& sampler, const float* xs, const float* ys, int count, uint32_t* out)
+{
+    const int from = (Mode == BicubicBestFitSampler::LOCAL_4x4) ? 0 : 1;
+    const int to = (Mode == BicubicBestFitSampler::LOCAL_4x4) ? 3 : 2;
+    const PixelBuffer& pixels = sampler.pixels;
+    const uint32_t* base = pixels.getAddressing().base;
+    int stride = pixels.getStride();
+    for (int i = 0; i < count; i++)
+    {
+        int offset, phaseX, phaseY;
+        if (!_bicubicFootprint(pixels, xs[i], ys[i], offset, phaseX, phaseY))
+        {
+            out[i] = BLANK_PIXEL;
+            continue;
+        }
+        const uint32_t* p = base + offset;
+        float rgb[3];
+        if (Mode == BicubicBestFitSampler::PALETTE)
+        {
+            _exactBicubic(p, stride, xs[i], ys[i], rgb);
+            out[i] = sampler.palette->nearest(constrain((int)(255 * rgb[0]), 0, 255),
+                                              constrain((int)(255 * rgb[1]), 0, 255),
+                                              constrain((int)(255 * rgb[2]), 0, 255));
+            continue;
+        }
+
+        float c[4];
+        _bicubicChannels(p, stride, CATMULL_ROM.weights[phaseX], CATMULL_ROM.weights[phaseY], c);
+
+        //  the best fitting color (least squares) and the nearest one of another color
+        float errors[16];
+        uint32_t candidates[16];
+        int n = 0;
+        int best = 0;
+        for (int ox = from; ox <= to; ox++)
+            for (int oy = from; oy <= to; oy++, n++)
+            {
+                uint32_t pxl = p[oy * stride + ox];
+                float b = (0xFF & pxl) - c[0];
+                float g = (0xFF & (pxl >> 8)) - c[1];
+                float r = (0xFF & (pxl >> 16)) - c[2];
+                candidates[n] = pxl;
+                errors[n] = r*r + g*g + b*b;
+                if (errors[n] < errors[best])
+                    best = n;
+            }
+        float second = std::numeric_limits<float>::max();
+        for (int k = 0; k < n; k++)
+            if (((candidates[k] ^ candidates[best]) & 0x00FFFFFF) != 0)
+                second = std::min(second, errors[k]);
+        float margin = std::sqrt(errors[best]) + 2 * BEST_FIT_SLACK;
+        if (second >= margin * margin)
+        {
+            out[i] = candidates[best];
+            continue;
+        }
+
+        //  the same comparison as operator()
+        _exactBicubic(p, stride, xs[i], ys[i], rgb);
+        float least = std::numeric_limits<float>::max();
+        for (int k = 0; k < n; k++)
+        {
+            float r = (0xFF & (candidates[k] >> 16)) / 255.0f - rgb[0];
+            float g = (0xFF & (candidates[k] >> 8)) / 255.0f - rgb[1];
+            float b = (0xFF & candidates[k]) / 255.0f - rgb[2];
+            float error = r*r + g*g + b*b;
+            if (error < least)
+            {
+                least = error;
+                best = k;
+            }
+        }
+        out[i] = candidates[best];
+    }
+}
+
+void BicubicBestFitSampler::sampleRow(const float* xs, const float* ys, int count, uint32_t* out)
+{
+    if (mode == PALETTE && palette)
+        _bestFitRow<PALETTE>(*this, xs, ys, count, out);
+    else if (mode == LOCAL_4x4)
+        _bestFitRow<LOCAL_4x4>(*this, xs, ys, count, out);
+    else
+        _bestFitRow<LOCAL_2x2>(*this, xs, ys, count, out);
+}
+
 ci::ColorA8u BicubicBestFitSampler::operator()(float x, float y)
 {
     /*
@@ -444,18 +3092,10 @@ ci::ColorA8u BicubicBestFitSampler::operator()(float x, float y)
     float best = std::numeric_limits<float>::max();
     if (mode == PALETTE && palette)
     {
-        ColorA8u pxl(255 * r, 255 * g, 255 * b);
-        for (Palette::iterator it = palette->begin(); it != palette->end(); it++)
-        {
-            float error = distance2(ColorA8u(it->r, it->g, it->b), pxl);
-            if (error < best)  // found
-            {
-                result = *it;
-                best = error;
-            }
-            if (error == 0)
-                break;
-        }
+        if (!palette->empty())
+            result = unpackPixel(palette->nearest(constrain((int)(255 * r), 0, 255),
+                                                  constrain((int)(255 * g), 0, 255),
+                                                  constrain((int)(255 * b), 0, 255)));
     }
     else
     {
@@ -484,14 +3124,64 @@ ci::ColorA8u BicubicBestFitSampler::operator()(float x, float y)
 // ***
 // ***
 
-template Surface pp::transform<WeightSampler>(WeightSampler& source, TransformMapping& targetMapping, TransformMethod method);
+template Surface pp::transform<WeightSampler>(WeightSampler& source, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template Surface pp::transform<WeightSampler>(WeightSampler& source, const CoordinateMap& coordinates, const TransformOptions& options);
+template Surface pp::transformScaled<WeightSampler>(WeightSampler& source, ScaleMethod scaleMethod, TransformMapping& targetMapping, TransformMethod method, const TransformOptions& options);
+template std::vector<Surface> pp::transformFrames<WeightSampler>(WeightSampler& source, ScaleMethod scaleMethod, std::vector<TransformMapping>& targetMappings, TransformMethod method, const TransformOptions& options);
 
 WeightSampler::WeightSampler(cinder::Surface& src, int sampleOrder)
 {
     source = src;
+    pixels = PixelBuffer(src, 1, _sourceLayout(src));
+    indexed = IndexedPixels(pixels);
+    if (!indexed.empty())
+        pixels = PixelBuffer();
     order = sampleOrder;
 }
 
+void WeightSampler::sampleRow(const float* xs, const float* ys, int count, uint32_t* out)
+{
+    DominanceSample sample;
+    for (int i = 0; i < count; i++)
+    {
+        if (!_isInside(source, xs[i], ys[i]))
+        {
+            out[i] = BLANK_PIXEL;
+            continue;
+        }
+        _dominance(pixels, indexed, xs[i], ys[i], sample);
+        uint32_t weight = (order == 0) ? sample.firstWeight : sample.secondWeight;
+        out[i] = 0xFF000000 | (weight << 16);
+    }
+}
+
+// ***
+// ***
+// ***
+
+BilinearDominanceSetSampler::BilinearDominanceSetSampler(cinder::Surface& src)
+{
+    source = src;
+    pixels = PixelBuffer(src, 1, _sourceLayout(src));
+    indexed = IndexedPixels(pixels);
+    if (!indexed.empty())
+        pixels = PixelBuffer();
+}
+
+void BilinearDominanceSetSampler::sampleRow(const float* xs, const float* ys, int count, DominanceSample* out)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (_isInside(source, xs[i], ys[i]))
+            _dominance(pixels, indexed, xs[i], ys[i], out[i]);
+        else
+        {
+            out[i].first = out[i].second = BLANK_PIXEL;
+            out[i].firstWeight = out[i].secondWeight = 0;
+        }
+    }
+}
+
 ColorA8u WeightSampler::operator()(float x, float y)
 {
     /*
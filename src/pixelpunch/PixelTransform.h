@@ -3,12 +3,18 @@
 #include "cinder/Cinder.h"
 #include "cinder/Surface.h"
 #include "cinder/Rect.h"
+#include "PixelBuffer.h"
+#include "PixelPalette.h"
+#include "PixelScale.h"
+#include <memory>
+#include <vector>
 
 namespace pp
 {
     enum TransformMethod {
         TM_IDENTITY,
         TM_PROJECTIVE,
+        TM_ROTATE_SHEAR,    // projective, but rotations are drawn as three 1D shears
         TM_BILINEAR
     };
     typedef enum TransformMethod TransformMethod;
@@ -21,10 +27,65 @@ namespace pp
         ci::Rectf bounds;
     };
 
+    struct TransformOptions
+    {
+        TransformOptions() : supersampling(1), edgeThreshold(0), separableDrift(0), fixedPoint(false) {}
+        int supersampling;  // samples per axis on edge pixels, 1 takes a single sample everywhere
+        int edgeThreshold;  // largest channel difference to a neighbour that still counts as flat
+        // Above 0 BilinearSampler and BicubicSampler draw projective mappings in two 1D passes,
+        // rows first, where no target column drifts more than this many source pixels sideways
+        // per source row. With L the largest channel difference between horizontal neighbours
+        // in the source, channels then differ from sampling by at most drift * L + 1 for
+        // bilinear and 2 * drift * L + 1 for bicubic. It pays off for bicubic, bilinear about breaks even.
+        float separableDrift;
+        // Maps with integers onto the 1/512 grid the samplers use and samples bicubic with integer
+        // weights, so the result does not depend on compiler, SIMD width or thread count; the
+        // only floating point left is setting up the mapping in double. Two pass warps and
+        // shears are not taken. See CoordinateMap for TM_BILINEAR.
+        bool fixedPoint;
+    };
+
+    // Source coordinates of every target pixel of one mapping, so that switching samplers only
+    // repeats the sampling. Rows hold width + 1 coordinates and there are height + 1 of them,
+    // the extra ones are the neighbours footprint samplers look at. Copies share the data.
+    // With fixedPoint coordinates are integer mapped onto the 1/512 grid (see TransformOptions),
+    // TM_BILINEAR keeps its float inverse and is only rounded down onto the grid.
+    class CoordinateMap
+    {
+     public:
+        CoordinateMap();
+        CoordinateMap(const cinder::Area& sourceBounds, const TransformMapping& targetMapping, TransformMethod method,
+                      bool fixedPoint = false);
+
+        // true if built for this source size, quad, method and precision
+        bool isFor(const cinder::Area& sourceBounds, const TransformMapping& targetMapping, TransformMethod method,
+                   bool fixedPoint = false) const;
+
+        const cinder::Area& getSourceBounds() const { return mSourceBounds; }
+        const TransformMapping& getTargetMapping() const { return mTargetMapping; }
+        TransformMethod getMethod() const { return mMethod; }
+        bool isFixedPoint() const { return mFixedPoint; }
+        int getWidth() const { return mWidth; }  // of the target
+        int getHeight() const { return mHeight; }
+        const float* getXs(int y) const { return &(*mXs)[y * (mWidth + 1)]; }  // y in [0, height]
+        const float* getYs(int y) const { return &(*mYs)[y * (mWidth + 1)]; }
+
+     private:
+        cinder::Area mSourceBounds;
+        TransformMapping mTargetMapping;
+        TransformMethod mMethod;
+        bool mFixedPoint;
+        int mWidth;
+        int mHeight;
+        std::shared_ptr<std::vector<float> > mXs;
+        std::shared_ptr<std::vector<float> > mYs;
+    };
+
     enum SamplingMethod {
         SAMPLE_NEAREST,
         SAMPLE_BILINEAR,
         SAMPLE_BICUBIC,
+        SAMPLE_AREA,
         SAMPLE_FIRST_BILINEAR,
         SAMPLE_SECOND_BILINEAR,
         SAMPLE_BEST_FIT_NARROW,
@@ -32,37 +93,69 @@ namespace pp
         SAMPLE_BEST_FIT_ANY,
         SAMPLE_FIRST_WEIGHT,
         SAMPLE_SECOND_WEIGHT,
-        SAMPLE_MINIMIZE_ERROR
+        SAMPLE_MINIMIZE_ERROR,
+        SAMPLE_ROTSPRITE
     };
     typedef enum SamplingMethod SamplingMethod;
 
+    //  the border decides what the row samplers blend in at the edges of the source, WRAP
+    //  for tileable textures; samples outside the source stay blank
     struct NearestNeighbourSampler
     {
-        NearestNeighbourSampler(cinder::Surface& src);
+        NearestNeighbourSampler(cinder::Surface& src, PixelBuffer::Border border = PixelBuffer::BORDER_CLAMP);
         ci::Surface source;
+        PixelBuffer pixels;
         ci::ColorA8u operator()(float x, float y);
+        // samples a whole row of coordinates into packed pixels, blank where outside the source
+        void sampleRow(const float* xs, const float* ys, int count, uint32_t* out);
     };
 
     struct BilinearSampler
     {
-        BilinearSampler(cinder::Surface& src);
+        BilinearSampler(cinder::Surface& src, PixelBuffer::Border border = PixelBuffer::BORDER_CLAMP);
         ci::Surface source;
+        PixelBuffer pixels;
         ci::ColorA8u operator()(float x, float y);
+        void sampleRow(const float* xs, const float* ys, int count, uint32_t* out);
     };
 
     struct BicubicSampler
     {
-        BicubicSampler(cinder::Surface& src);
+        BicubicSampler(cinder::Surface& src, PixelBuffer::Border border = PixelBuffer::BORDER_CLAMP);
         ci::Surface source;
+        PixelBuffer pixels;
         ci::ColorA8u operator()(float x, float y);
+        void sampleRow(const float* xs, const float* ys, int count, uint32_t* out);
     };
     
+    //  averages the source over the footprint of a target pixel, for minifying transforms.
+    //  Footprints come from the distance to the neighbouring samples of the same row and,
+    //  when given, the next row; a mip level per halving is built the first time it is needed.
+    struct AreaSampler
+    {
+        AreaSampler(cinder::Surface& src);
+        ci::Surface source;
+        PixelBuffer pixels;
+        std::shared_ptr<MipPyramid> mips;
+        ci::ColorA8u operator()(float x, float y);
+        void sampleRow(const float* xs, const float* ys, int count, uint32_t* out);
+        // xs, ys hold count + 1 coordinates, the last one right of the row, nextXs, nextYs
+        // those of the row below
+        void sampleRow(const float* xs, const float* ys, const float* nextXs, const float* nextYs, int count, uint32_t* out);
+    };
+
+    //  the dominance samplers vote on color indices when the source has at most 256 colors
+    //  (see IndexedPixels), with the same result; they then hold a byte per pixel and pixels
+    //  stays empty
     struct BilinearDominanceSampler
     {
         BilinearDominanceSampler(cinder::Surface& src, int sampleOrder);
         ci::Surface source;
+        PixelBuffer pixels;
+        IndexedPixels indexed;
         int order; //0 = most dominant, 1 = 2nd most dominant...
         ci::ColorA8u operator()(float x, float y);
+        void sampleRow(const float* xs, const float* ys, int count, uint32_t* out);
     };
 
     struct BicubicBestFitSampler
@@ -72,20 +165,105 @@ namespace pp
         BicubicBestFitSampler(cinder::Surface& src, bool allowOuterPixels);
         BicubicBestFitSampler(cinder::Surface& src, Palette& colors);
         ci::Surface source;
+        PixelBuffer pixels;
         ColorSelectMode mode;
-        Palette* palette;
+        std::shared_ptr<PaletteIndex> palette;
         ci::ColorA8u operator()(float x, float y);
+        void sampleRow(const float* xs, const float* ys, int count, uint32_t* out);
     };
 
     struct WeightSampler
     {
         WeightSampler(cinder::Surface& src, int sampleOrder);
         ci::Surface source;
+        PixelBuffer pixels;
+        IndexedPixels indexed;
         int order; //0 = most dominant, 1 = 2nd most dominant...
         ci::ColorA8u operator()(float x, float y);
+        void sampleRow(const float* xs, const float* ys, int count, uint32_t* out);
     };
 
+    //  what BilinearDominanceSampler and WeightSampler of order 0 and 1 return for one point
+    struct DominanceSample
+    {
+        uint32_t first;         // packed colors
+        uint32_t second;
+        uint32_t firstWeight;   // 0..255
+        uint32_t secondWeight;
+    };
+
+    //  samples both dominant colors and their weights with a single vote
+    struct BilinearDominanceSetSampler
+    {
+        BilinearDominanceSetSampler(cinder::Surface& src);
+        ci::Surface source;
+        PixelBuffer pixels;
+        IndexedPixels indexed;
+        void sampleRow(const float* xs, const float* ys, int count, DominanceSample* out);
+    };
+
+    //  samples source once per target pixel; with options.supersampling > 1 pixels on a color
+    //  edge of that first pass are sampled again on a regular grid and averaged
+    template<class Sampler>
+    cinder::Surface transform(Sampler& source, TransformMapping& targetMapping, TransformMethod method,
+                              const TransformOptions& options = TransformOptions());
+
+    //  the same as above, sampling over coordinates mapped before
+    template<class Sampler>
+    cinder::Surface transform(Sampler& source, const CoordinateMap& coordinates, const TransformOptions& options = TransformOptions());
+
+    //  samples scale(source.source, scaleMethod) without ever holding all of it: each tile of
+    //  the target scales just the region its samples fall in and samples it with a copy of
+    //  source. The same result as scaling first; non-local scale methods, supersampling,
+    //  AreaSampler, the dominance and weight samplers and wrapped borders take that way.
+    template<class Sampler>
+    cinder::Surface transformScaled(Sampler& source, ScaleMethod scaleMethod, TransformMapping& targetMapping, TransformMethod method,
+                                    const TransformOptions& options = TransformOptions());
+
+    //  a frame per mapping, the same as transformScaled for each, but the source is scaled
+    //  and the sampler prepared once for all of them; frames are drawn in parallel
     template<class Sampler>
-    cinder::Surface transform(Sampler& source, TransformMapping& targetMapping, TransformMethod method);
+    std::vector<cinder::Surface> transformFrames(Sampler& source, ScaleMethod scaleMethod, std::vector<TransformMapping>& targetMappings,
+                                                 TransformMethod method, const TransformOptions& options = TransformOptions());
+
+    //  targetRect turned about its center by each angle (radians), for the facings of a sprite
+    std::vector<TransformMapping> rotationMappings(const cinder::Rectf& targetRect, const std::vector<float>& angles);
+
+    //  renders the most and second most dominant colors in one pass, weights gets the weight
+    //  of the first in red and of the second in green (red matches WeightSampler order 0)
+    void transformDominance(BilinearDominanceSetSampler& source, TransformMapping& targetMapping, TransformMethod method,
+                            cinder::Surface& first, cinder::Surface& second, cinder::Surface& weights);
+    void transformDominance(BilinearDominanceSetSampler& source, const CoordinateMap& coordinates,
+                            cinder::Surface& first, cinder::Surface& second, cinder::Surface& weights);
+
+    //  how transform() below builds the sampler of a SamplingMethod
+    struct SamplingOptions
+    {
+        SamplingOptions() : border(PixelBuffer::BORDER_CLAMP), palette(nullptr), mixThreshold(0.25f) {}
+        PixelBuffer::Border border;     // of the nearest neighbour, bilinear and bicubic samplers
+        Palette* palette;               // colors for SAMPLE_BEST_FIT_ANY, those of the source if null
+        float mixThreshold;             // of SAMPLE_MINIMIZE_ERROR
+    };
+
+    //  the sampler of method over coordinates, through a table of the transform above
+    //  instantiated for each method, so the enum is only looked at once per call
+    cinder::Surface transform(cinder::Surface& source, SamplingMethod method, const CoordinateMap& coordinates,
+                              const TransformOptions& options = TransformOptions(), const SamplingOptions& sampling = SamplingOptions());
+
+    //  "Bilinear Mix" in one streaming pass: the same result as choose(first, second,
+    //  compare(bicubic, first), weights, threshold) without any full size intermediates
+    //  besides the coordinates, which can be mapped before and shared
+    cinder::Surface transformMix(cinder::Surface& source, TransformMapping& targetMapping, TransformMethod method, float threshold);
+    cinder::Surface transformMix(cinder::Surface& source, const CoordinateMap& coordinates, float threshold);
+    //  everything of transformMix but the threshold, for choose(scores, threshold) to redo
+    //  just the last step when only the threshold changes
+    SwapScores mixScores(cinder::Surface& source, const CoordinateMap& coordinates);
+
+    //  RotSprite: Scale2x three times, a nearest neighbour transform of that and the target
+    //  at the size of targetMapping. Only the first Scale2x pass is held, per tile and for
+    //  the part of the source the tile samples. TM_ROTATE_SHEAR samples like TM_PROJECTIVE;
+    //  the second overload takes coordinates mapped for source itself.
+    cinder::Surface transformRotSprite(cinder::Surface& source, TransformMapping& targetMapping, TransformMethod method);
+    cinder::Surface transformRotSprite(cinder::Surface& source, const CoordinateMap& coordinates);
 
 } //namespace pp